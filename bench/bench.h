@@ -0,0 +1,56 @@
+#pragma once
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+/**
+ * Returns a timestamp in seconds, only meant for measuring durations.
+ */
+static inline double bench_now(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (double) now.tv_sec + (double) now.tv_nsec * 1e-9;
+}
+
+/**
+ * xorshift64, good enough to pick keys and shuffle inputs.
+ */
+static inline uint64_t bench_random(uint64_t* state)
+{
+    *state ^= *state << 13;
+    *state ^= *state >> 7;
+    *state ^= *state << 17;
+    return *state;
+}
+
+/**
+ * Keeps the compiler from dropping the computation of `value`.
+ */
+static inline void bench_keep(uint64_t value)
+{
+    volatile uint64_t sink = value;
+    (void) sink;
+}
+
+/**
+ * Returns the number of online processors, at least 1.
+ */
+static inline size_t bench_cpus(void)
+{
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    return cpus > 0 ? (size_t) cpus : 1;
+}
+
+/**
+ * Returns the `index`th command line argument as a number, or `fallback` if
+ * there's none.
+ */
+static inline size_t bench_arg(int argc, char** argv, int index, size_t fallback)
+{
+    return index < argc ? (size_t) strtoull(argv[index], NULL, 10) : fallback;
+}
@@ -0,0 +1,106 @@
+#include "bench.h"
+#include "marlo/concurrent_hash_table.h"
+
+#include <pthread.h>
+#include <stdio.h>
+
+#define KEY(i) ((const void*) (uintptr_t) ((i) * 8 + 8))
+
+/**
+ * Work of a thread: `operations` lookups of random keys, one in
+ * `write_every` of them replaced by a push if non-zero.
+ */
+typedef struct bench_task_t {
+    concurrent_hash_table_t* table;
+    size_t keys;
+    size_t operations;
+    size_t write_every;
+    uint64_t seed;
+    size_t found;
+} bench_task_t;
+
+static void* bench_run(void* arg)
+{
+    bench_task_t* task = (bench_task_t*) arg;
+    uint64_t state = task->seed;
+    size_t found = 0;
+    for (size_t i = 0; i < task->operations; i++) {
+        size_t key = (size_t) (bench_random(&state) % task->keys);
+        if (task->write_every > 0 && i % task->write_every == 0) {
+            concurrent_hash_table_push(task->table, KEY(key), KEY(key + 1));
+        } else {
+            found += concurrent_hash_table_at(task->table, KEY(key)) != NULL;
+        }
+    }
+
+    task->found = found;
+    return NULL;
+}
+
+/**
+ * Runs `threads` threads doing `operations` operations each, returns the
+ * throughput in millions of operations per second.
+ */
+static double bench_threads(concurrent_hash_table_t* table, size_t keys, size_t threads, size_t operations, size_t write_every)
+{
+    pthread_t ids[256];
+    bench_task_t tasks[256];
+    double start = bench_now();
+    for (size_t i = 0; i < threads; i++) {
+        tasks[i].table = table;
+        tasks[i].keys = keys;
+        tasks[i].operations = operations;
+        tasks[i].write_every = write_every;
+        tasks[i].seed = 0x9e3779b97f4a7c15 * (i + 1);
+        tasks[i].found = 0;
+        if (pthread_create(&ids[i], NULL, bench_run, &tasks[i]) != 0) {
+            bench_run(&tasks[i]);
+            ids[i] = pthread_self();
+        }
+    }
+
+    for (size_t i = 0; i < threads; i++) {
+        if (!pthread_equal(ids[i], pthread_self())) {
+            pthread_join(ids[i], NULL);
+        }
+    }
+
+    return (double) (threads * operations) / (bench_now() - start) / 1e6;
+}
+
+/**
+ * Usage: concurrent_hash_table_bench [keys] [operations per thread] [max threads]
+ * Reports lookup throughput and its speedup over a single thread for 1, 2,
+ * 4, ... threads, read-only and with 10% writes.
+ */
+int main(int argc, char** argv)
+{
+    size_t keys = bench_arg(argc, argv, 1, 1000000);
+    size_t operations = bench_arg(argc, argv, 2, 4000000);
+    size_t max_threads = bench_arg(argc, argv, 3, bench_cpus());
+    max_threads = max_threads < 256 ? max_threads : 256;
+
+    concurrent_hash_table_t* table = concurrent_hash_table_new(HASH_TABLE_ADDRESS, keys);
+    if (table == NULL) {
+        return 1;
+    }
+
+    for (size_t i = 0; i < keys; i++) {
+        concurrent_hash_table_push(table, KEY(i), KEY(i + 1));
+    }
+
+    printf("%zu keys, %zu operations per thread, %zu cpus\n", keys, operations, bench_cpus());
+    printf("threads  reads Mops/s  speedup  90/10 Mops/s  speedup\n");
+    double reads_base = 0;
+    double mixed_base = 0;
+    for (size_t threads = 1; threads <= max_threads; threads *= 2) {
+        double reads = bench_threads(table, keys, threads, operations, 0);
+        double mixed = bench_threads(table, keys, threads, operations, 10);
+        reads_base = threads == 1 ? reads : reads_base;
+        mixed_base = threads == 1 ? mixed : mixed_base;
+        printf("%7zu  %12.1f  %6.2fx  %12.1f  %6.2fx\n", threads, reads, reads / reads_base, mixed, mixed / mixed_base);
+    }
+
+    concurrent_hash_table_release(table);
+    return 0;
+}
@@ -0,0 +1,187 @@
+#include "bench.h"
+#include "hash.h"
+
+#include <stdio.h>
+
+#define DISTRIBUTION_BITS 16
+#define FNV_OFFSET UINT64_C(0xcbf29ce484222325)
+#define FNV_PRIME UINT64_C(0x100000001b3)
+
+/**
+ * The byte at a time FNV-1a `hash_table_t` used before xxHash64.
+ */
+static uint64_t fnv_bytes(const void* key, size_t size)
+{
+    const unsigned char* bytes = (const unsigned char*) key;
+    uint64_t hash = FNV_OFFSET;
+    for (size_t i = 0; i < size; i++) {
+        hash *= FNV_PRIME;
+        hash ^= bytes[i];
+    }
+
+    return hash;
+}
+
+/**
+ * The old FNV-1a over the bytes of an address, most significant first.
+ */
+static uint64_t fnv_address(const void* key)
+{
+    uintptr_t address = (uintptr_t) key;
+    uint64_t hash = FNV_OFFSET;
+    for (size_t i = 0; i < sizeof(uintptr_t); i++) {
+        hash *= FNV_PRIME;
+        hash ^= (address >> (sizeof(uintptr_t) - 1 - i) * 8) & 0xff;
+    }
+
+    return hash;
+}
+
+/**
+ * Hash throughput over keys of a few sizes, in GB/s, and nanoseconds per
+ * address key including the reduction to a slot.
+ */
+static void bench_throughput(size_t total)
+{
+    static const size_t sizes[] = {8, 16, 32, 64, 256, 4096};
+    unsigned char* data = (unsigned char*) malloc(4096 + 64);
+    if (data == NULL) {
+        return;
+    }
+
+    uint64_t state = FIBONACCI;
+    for (size_t i = 0; i < 4096 + 64; i++) {
+        data[i] = (unsigned char) bench_random(&state);
+    }
+
+    uint64_t sink = 0;
+    uint64_t seed[2] = {1, 2};
+    printf("bytes   fnv GB/s  xxhash GB/s  siphash GB/s\n");
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(*sizes); s++) {
+        size_t size = sizes[s];
+        size_t count = total / size;
+        double start = bench_now();
+        for (size_t i = 0; i < count; i++) {
+            sink += fnv_bytes(data + (i & 63), size);
+        }
+        double fnv = bench_now() - start;
+
+        start = bench_now();
+        for (size_t i = 0; i < count; i++) {
+            sink += hash_bytes(data + (i & 63), size, 0);
+        }
+        double xxhash = bench_now() - start;
+
+        start = bench_now();
+        for (size_t i = 0; i < count; i++) {
+            sink += hash_keyed(data + (i & 63), size, seed);
+        }
+        double siphash = bench_now() - start;
+
+        double bytes = (double) (count * size) / 1e9;
+        printf("%5zu  %9.2f  %11.2f  %12.2f\n", size, bytes / fnv, bytes / xxhash, bytes / siphash);
+    }
+
+    volatile size_t opaque = (size_t) 1 << 20;
+    size_t capacity = opaque;
+    int shift = 64 - 20;
+    size_t count = total / 8;
+    double start = bench_now();
+    for (size_t i = 0; i < count; i++) {
+        sink += fnv_address((const void*) (uintptr_t) (i * 8)) % capacity;
+    }
+    double fnv = bench_now() - start;
+
+    start = bench_now();
+    for (size_t i = 0; i < count; i++) {
+        sink += hash_address((const void*) (uintptr_t) (i * 8)) >> shift;
+    }
+    double fibonacci = bench_now() - start;
+
+    printf("address to slot: fnv + modulo %.2f ns, fibonacci + shift %.2f ns\n", fnv / (double) count * 1e9,
+        fibonacci / (double) count * 1e9);
+    bench_keep(sink);
+    free(data);
+}
+
+/**
+ * Chi-square of the bucket counts over its expected value, about 1 when keys
+ * spread like random ones and much larger when they cluster.
+ */
+static double bench_chi_square(const size_t* counts, size_t buckets, size_t keys)
+{
+    double expected = (double) keys / (double) buckets;
+    double sum = 0;
+    for (size_t i = 0; i < buckets; i++) {
+        double delta = (double) counts[i] - expected;
+        sum += delta * delta / expected;
+    }
+
+    return sum / (double) (buckets - 1);
+}
+
+/**
+ * Spreads `keys` keys of the given kind over 2^DISTRIBUTION_BITS buckets, the
+ * old way (FNV-1a modulo the capacity) and the new one (top bits of the new
+ * hashes), and prints the chi-square ratio and the fullest bucket of each.
+ */
+static void bench_distribution(const char* name, int strings, const char* format, size_t keys)
+{
+    size_t buckets = (size_t) 1 << DISTRIBUTION_BITS;
+    size_t* old_counts = (size_t*) calloc(buckets, sizeof(size_t));
+    size_t* new_counts = (size_t*) calloc(buckets, sizeof(size_t));
+    if (old_counts == NULL || new_counts == NULL) {
+        free(old_counts);
+        free(new_counts);
+        return;
+    }
+
+    char key[64];
+    for (size_t i = 0; i < keys; i++) {
+        uint64_t old_hash = 0;
+        uint64_t new_hash = 0;
+        if (strings) {
+            int size = snprintf(key, sizeof(key), format, i);
+            old_hash = fnv_bytes(key, (size_t) size);
+            new_hash = hash_bytes(key, (size_t) size, 0);
+        } else {
+            const void* address = (const void*) (uintptr_t) (i * 16 + 0x10000);
+            old_hash = fnv_address(address);
+            new_hash = hash_address(address);
+        }
+
+        old_counts[old_hash % buckets]++;
+        new_counts[new_hash >> (64 - DISTRIBUTION_BITS)]++;
+    }
+
+    size_t old_max = 0;
+    size_t new_max = 0;
+    for (size_t i = 0; i < buckets; i++) {
+        old_max = old_counts[i] > old_max ? old_counts[i] : old_max;
+        new_max = new_counts[i] > new_max ? new_counts[i] : new_max;
+    }
+
+    printf("%-22s  %10.2f  %7zu  %10.2f  %7zu\n", name, bench_chi_square(old_counts, buckets, keys), old_max,
+        bench_chi_square(new_counts, buckets, keys), new_max);
+    free(old_counts);
+    free(new_counts);
+}
+
+/**
+ * Usage: hash_bench [bytes hashed per size]
+ * Compares the old FNV-1a with xxHash64, SipHash-1-3 and Fibonacci hashing
+ * on throughput and on how evenly they spread common key sets.
+ */
+int main(int argc, char** argv)
+{
+    size_t total = bench_arg(argc, argv, 1, 256 << 20);
+    bench_throughput(total);
+
+    size_t keys = ((size_t) 3 << DISTRIBUTION_BITS) / 4;
+    printf("\n%zu keys in %d buckets\n", keys, 1 << DISTRIBUTION_BITS);
+    printf("keys                    fnv chi^2  fnv max  new chi^2  new max\n");
+    bench_distribution("addresses, stride 16", 0, NULL, keys);
+    bench_distribution("decimal strings", 1, "%zu", keys);
+    bench_distribution("route paths", 1, "/api/v1/users/%zu/posts", keys);
+    return 0;
+}
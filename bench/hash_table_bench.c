@@ -0,0 +1,369 @@
+#include "bench.h"
+#include "marlo/frozen_hash_table.h"
+#include "marlo/hash_table.h"
+
+#include <stdio.h>
+
+#define KEY(i) ((const void*) (uintptr_t) ((i) * 8 + 8))
+#define FIBONACCI_SEED UINT64_C(0x9e3779b97f4a7c15)
+#define PATH_SIZE 48
+#define CHAIN_RESIZE_FACTOR 2
+#define CHAIN_MAX_LOAD_FACTOR 0.75
+
+typedef struct chain_node_t chain_node_t;
+
+struct chain_node_t {
+    const void* key;
+    const void* value;
+    chain_node_t* next;
+};
+
+typedef struct chain_list_t {
+    chain_node_t* head;
+    size_t size;
+} chain_list_t;
+
+/**
+ * The separate chaining table `hash_table_t` used before Robin Hood hashing:
+ * a malloc'd list per used bucket, a malloc'd node per entry and FNV-1a
+ * reduced with a modulo.
+ * `bytes` counts what it allocated, allocator overhead excluded.
+ */
+typedef struct chain_table_t {
+    chain_list_t** buckets;
+    size_t capacity;
+    size_t size;
+    size_t bytes;
+} chain_table_t;
+
+static size_t chain_hash(const void* key, size_t capacity)
+{
+    uint64_t hash = 0xcbf29ce484222325;
+    uintptr_t address = (uintptr_t) key;
+    for (size_t i = 0; i < sizeof(uintptr_t); i++) {
+        hash *= 0x100000001b3;
+        hash ^= (address >> (sizeof(uintptr_t) - 1 - i) * 8) & 0xff;
+    }
+
+    return (size_t) (hash % capacity);
+}
+
+static int chain_insert(chain_list_t** buckets, size_t capacity, chain_node_t* node, size_t* bytes)
+{
+    size_t pos = chain_hash(node->key, capacity);
+    if (buckets[pos] == NULL) {
+        buckets[pos] = (chain_list_t*) calloc(1, sizeof(chain_list_t));
+        if (buckets[pos] == NULL) {
+            return -1;
+        }
+
+        *bytes += sizeof(chain_list_t);
+    }
+
+    node->next = buckets[pos]->head;
+    buckets[pos]->head = node;
+    buckets[pos]->size++;
+    return 0;
+}
+
+static int chain_rehash(chain_table_t* table)
+{
+    size_t capacity = table->capacity > 0 ? table->capacity * CHAIN_RESIZE_FACTOR : 16;
+    chain_list_t** buckets = (chain_list_t**) calloc(capacity, sizeof(chain_list_t*));
+    if (buckets == NULL) {
+        return -1;
+    }
+
+    size_t bytes = table->size * sizeof(chain_node_t) + capacity * sizeof(chain_list_t*);
+    for (size_t i = 0; i < table->capacity; i++) {
+        chain_list_t* list = table->buckets[i];
+        chain_node_t* node = list != NULL ? list->head : NULL;
+        while (node != NULL) {
+            chain_node_t* next = node->next;
+            if (chain_insert(buckets, capacity, node, &bytes) == -1) {
+                return -1;
+            }
+
+            node = next;
+        }
+
+        free(list);
+    }
+
+    free(table->buckets);
+    table->buckets = buckets;
+    table->capacity = capacity;
+    table->bytes = bytes;
+    return 0;
+}
+
+static int chain_push(chain_table_t* table, const void* key, const void* value)
+{
+    if (table->capacity == 0 || (double) table->size >= (double) table->capacity * CHAIN_MAX_LOAD_FACTOR) {
+        if (chain_rehash(table) == -1) {
+            return -1;
+        }
+    }
+
+    chain_list_t* list = table->buckets[chain_hash(key, table->capacity)];
+    for (chain_node_t* node = list != NULL ? list->head : NULL; node != NULL; node = node->next) {
+        if (node->key == key) {
+            node->value = value;
+            return 0;
+        }
+    }
+
+    chain_node_t* node = (chain_node_t*) malloc(sizeof(chain_node_t));
+    if (node == NULL) {
+        return -1;
+    }
+
+    node->key = key;
+    node->value = value;
+    table->size++;
+    table->bytes += sizeof(chain_node_t);
+    return chain_insert(table->buckets, table->capacity, node, &table->bytes);
+}
+
+static const void* chain_at(const chain_table_t* table, const void* key)
+{
+    chain_list_t* list = table->buckets[chain_hash(key, table->capacity)];
+    for (chain_node_t* node = list != NULL ? list->head : NULL; node != NULL; node = node->next) {
+        if (node->key == key) {
+            return node->value;
+        }
+    }
+
+    return NULL;
+}
+
+static void chain_release(chain_table_t* table)
+{
+    for (size_t i = 0; i < table->capacity; i++) {
+        chain_list_t* list = table->buckets[i];
+        chain_node_t* node = list != NULL ? list->head : NULL;
+        while (node != NULL) {
+            chain_node_t* next = node->next;
+            free(node);
+            node = next;
+        }
+
+        free(list);
+    }
+
+    free(table->buckets);
+}
+
+/**
+ * Robin Hood open addressing against the old separate chaining: nanoseconds
+ * per push, per hit and per miss, and bytes allocated per entry.
+ */
+static int bench_chaining(size_t keys, const void** probes, const void** misses, size_t lookups)
+{
+    hash_table_t* table = hash_table_new(HASH_TABLE_ADDRESS, 0);
+    chain_table_t chain = {NULL, 0, 0, 0};
+    if (table == NULL) {
+        return -1;
+    }
+
+    double start = bench_now();
+    for (size_t i = 0; i < keys; i++) {
+        hash_table_push(table, KEY(i), KEY(i + 1));
+    }
+    double push = bench_now() - start;
+
+    start = bench_now();
+    for (size_t i = 0; i < keys; i++) {
+        chain_push(&chain, KEY(i), KEY(i + 1));
+    }
+    double chain_push_time = bench_now() - start;
+
+    size_t found = 0;
+    start = bench_now();
+    for (size_t i = 0; i < lookups; i++) {
+        found += hash_table_at(table, probes[i]) != NULL;
+    }
+    double hit = bench_now() - start;
+
+    start = bench_now();
+    for (size_t i = 0; i < lookups; i++) {
+        found += chain_at(&chain, probes[i]) != NULL;
+    }
+    double chain_hit = bench_now() - start;
+
+    start = bench_now();
+    for (size_t i = 0; i < lookups; i++) {
+        found += hash_table_at(table, misses[i]) != NULL;
+    }
+    double miss = bench_now() - start;
+
+    start = bench_now();
+    for (size_t i = 0; i < lookups; i++) {
+        found += chain_at(&chain, misses[i]) != NULL;
+    }
+    double chain_miss = bench_now() - start;
+
+    hash_table_stats_t stats;
+    hash_table_stats(table, &stats);
+    printf("                robin hood    chaining  (%zu found)\n", found);
+    printf("push ns         %10.1f  %10.1f\n", push / (double) keys * 1e9, chain_push_time / (double) keys * 1e9);
+    printf("hit ns          %10.1f  %10.1f\n", hit / (double) lookups * 1e9, chain_hit / (double) lookups * 1e9);
+    printf("miss ns         %10.1f  %10.1f\n", miss / (double) lookups * 1e9, chain_miss / (double) lookups * 1e9);
+    printf("bytes per entry %10.1f  %10.1f\n", (double) stats.total_bytes / (double) keys, (double) chain.bytes / (double) keys);
+
+    chain_release(&chain);
+    hash_table_release(table);
+    return 0;
+}
+
+/**
+ * Batched pushes and lookups against loops of single ones, in nanoseconds
+ * per key, on a table meant to be larger than the last level cache.
+ */
+static int bench_batched(size_t keys, const void** probes, size_t lookups)
+{
+    const void** inserted = (const void**) malloc(keys * sizeof(*inserted));
+    const void** values = (const void**) malloc(lookups * sizeof(*values));
+    hash_table_t* single = hash_table_new(HASH_TABLE_ADDRESS, 0);
+    hash_table_t* batched = hash_table_new(HASH_TABLE_ADDRESS, 0);
+    int error = inserted == NULL || values == NULL || single == NULL || batched == NULL ? -1 : 0;
+    if (error == 0) {
+        uint64_t state = FIBONACCI_SEED;
+        for (size_t i = 0; i < keys; i++) {
+            inserted[i] = KEY(bench_random(&state) % keys);
+        }
+
+        double start = bench_now();
+        for (size_t i = 0; i < keys; i++) {
+            hash_table_push(single, inserted[i], inserted[i]);
+        }
+        double push = bench_now() - start;
+
+        start = bench_now();
+        error = hash_table_push_many(batched, inserted, inserted, keys);
+        double push_many = bench_now() - start;
+
+        size_t found = 0;
+        start = bench_now();
+        for (size_t i = 0; i < lookups; i++) {
+            found += hash_table_at(batched, probes[i]) != NULL;
+        }
+        double at = bench_now() - start;
+
+        start = bench_now();
+        found += hash_table_at_many(batched, probes, lookups, values);
+        double at_many = bench_now() - start;
+
+        printf("\n                single     batched  (%zu found)\n", found);
+        printf("push ns         %10.1f  %10.1f\n", push / (double) keys * 1e9, push_many / (double) keys * 1e9);
+        printf("at ns           %10.1f  %10.1f\n", at / (double) lookups * 1e9, at_many / (double) lookups * 1e9);
+    }
+
+    hash_table_release(batched);
+    hash_table_release(single);
+    free(values);
+    free(inserted);
+    return error;
+}
+
+/**
+ * Lookups in a frozen table against `hash_table_at()` on the same keys, in
+ * nanoseconds per lookup, for the given keys (pointers to route paths in
+ * string mode).
+ */
+static int bench_frozen_mode(const char* name, int mode, const void** keys, size_t count, const void** probes, size_t lookups)
+{
+    hash_table_t* table = hash_table_new(mode, count);
+    if (table == NULL || hash_table_push_many(table, keys, keys, count) == -1) {
+        hash_table_release(table);
+        return -1;
+    }
+
+    frozen_hash_table_t* frozen = hash_table_freeze(table);
+    if (frozen == NULL) {
+        hash_table_release(table);
+        return -1;
+    }
+
+    size_t found = 0;
+    double start = bench_now();
+    for (size_t i = 0; i < lookups; i++) {
+        found += hash_table_at(table, probes[i]) != NULL;
+    }
+    double at = bench_now() - start;
+
+    start = bench_now();
+    for (size_t i = 0; i < lookups; i++) {
+        found += frozen_hash_table_at(frozen, probes[i]) != NULL;
+    }
+    double frozen_at = bench_now() - start;
+
+    printf("%-14s  %10.1f  %10.1f  (%zu found)\n", name, at / (double) lookups * 1e9, frozen_at / (double) lookups * 1e9, found);
+    frozen_hash_table_release(frozen);
+    hash_table_release(table);
+    return 0;
+}
+
+/**
+ * Frozen against dynamic lookups with address keys and with route path
+ * strings.
+ */
+static int bench_frozen(size_t keys, const void** probes, size_t lookups)
+{
+    const void** addresses = (const void**) malloc(keys * sizeof(*addresses));
+    const void** paths = (const void**) malloc(keys * sizeof(*paths));
+    const void** path_probes = (const void**) malloc(lookups * sizeof(*path_probes));
+    char* buffer = (char*) malloc(keys * PATH_SIZE);
+    int error = addresses == NULL || paths == NULL || path_probes == NULL || buffer == NULL ? -1 : 0;
+    if (error == 0) {
+        for (size_t i = 0; i < keys; i++) {
+            addresses[i] = KEY(i);
+            snprintf(buffer + i * PATH_SIZE, PATH_SIZE, "/api/v1/users/%zu", i);
+            paths[i] = buffer + i * PATH_SIZE;
+        }
+
+        for (size_t i = 0; i < lookups; i++) {
+            path_probes[i] = paths[((uintptr_t) probes[i] - 8) / 8];
+        }
+
+        printf("\nat ns               dynamic      frozen\n");
+        error = bench_frozen_mode("addresses", HASH_TABLE_ADDRESS, addresses, keys, probes, lookups);
+        error |= bench_frozen_mode("route paths", HASH_TABLE_STRING, paths, keys, path_probes, lookups);
+    }
+
+    free(buffer);
+    free(path_probes);
+    free(paths);
+    free(addresses);
+    return error;
+}
+
+/**
+ * Usage: hash_table_bench [keys] [lookups]
+ * Looks up `lookups` random keys among `keys` address keys, and as many
+ * random missing keys.
+ */
+int main(int argc, char** argv)
+{
+    size_t keys = bench_arg(argc, argv, 1, 1000000);
+    size_t lookups = bench_arg(argc, argv, 2, 4000000);
+    const void** probes = (const void**) malloc(lookups * sizeof(*probes));
+    const void** misses = (const void**) malloc(lookups * sizeof(*misses));
+    if (keys == 0 || probes == NULL || misses == NULL) {
+        return 1;
+    }
+
+    uint64_t state = FIBONACCI_SEED;
+    for (size_t i = 0; i < lookups; i++) {
+        probes[i] = KEY(bench_random(&state) % keys);
+        misses[i] = KEY(keys + bench_random(&state) % keys);
+    }
+
+    printf("%zu keys, %zu lookups\n", keys, lookups);
+    int error = bench_chaining(keys, probes, misses, lookups);
+    error |= bench_batched(keys, probes, lookups);
+    error |= bench_frozen(keys, probes, lookups);
+    free(misses);
+    free(probes);
+    return error == -1;
+}
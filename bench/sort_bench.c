@@ -0,0 +1,157 @@
+#include "bench.h"
+#include "marlo/vector.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#define PATTERNS 5
+#define FEW_UNIQUE 16
+
+static const char* const pattern_names[PATTERNS] = {"random", "sorted", "reversed", "few unique", "organ pipe"};
+
+static int compare(const void* a, const void* b)
+{
+    uintptr_t x = (uintptr_t) a;
+    uintptr_t y = (uintptr_t) b;
+    return (x > y) - (x < y);
+}
+
+static int compare_qsort(const void* a, const void* b)
+{
+    return compare(*(const void* const*) a, *(const void* const*) b);
+}
+
+/**
+ * Fills `values` with `count` values laid out in the given pattern.
+ */
+static void bench_pattern(int pattern, const void** values, size_t count)
+{
+    uint64_t state = UINT64_C(0x9e3779b97f4a7c15);
+    for (size_t i = 0; i < count; i++) {
+        uint64_t value = 0;
+        switch (pattern) {
+        case 0:
+            value = bench_random(&state) >> 1;
+            break;
+        case 1:
+            value = i;
+            break;
+        case 2:
+            value = count - i;
+            break;
+        case 3:
+            value = bench_random(&state) % FEW_UNIQUE;
+            break;
+        default:
+            value = i < count / 2 ? i : count - i;
+            break;
+        }
+
+        values[i] = (const void*) (uintptr_t) (value + 1);
+    }
+}
+
+/**
+ * Fills the vector with the given values, sorts it with `sort` and returns
+ * the time it took in milliseconds, or a negative time if the result doesn't
+ * match `expected`.
+ */
+static double bench_vector(vector_t* vector, int (*sort)(vector_t*, compare_t), const void** values,
+    const void** expected, size_t count)
+{
+    vector_clear(vector);
+    for (size_t i = 0; i < count; i++) {
+        vector_push(vector, values[i]);
+    }
+
+    double start = bench_now();
+    sort(vector, compare);
+    double elapsed = (bench_now() - start) * 1e3;
+    for (size_t i = 0; i < count; i++) {
+        if (vector_at(vector, i) != expected[i]) {
+            return -1;
+        }
+    }
+
+    return elapsed;
+}
+
+static size_t parallel_threads;
+
+static uint64_t key_value(const void* value, void* ctx)
+{
+    (void) ctx;
+    return (uint64_t) (uintptr_t) value;
+}
+
+static int sort_by_key(vector_t* vector, compare_t compare)
+{
+    (void) compare;
+    return vector_sort_by_key(vector, key_value, NULL);
+}
+
+static int sort_parallel(vector_t* vector, compare_t compare)
+{
+    return vector_sort_parallel(vector, compare, parallel_threads);
+}
+
+/**
+ * Usage: sort_bench [values] [max threads]
+ * Reports the time in milliseconds qsort, vector_sort, vector_stable_sort and
+ * vector_sort_by_key take on each input pattern, then the time
+ * vector_sort_parallel takes on 1, 2, 4, ... threads, checking the results
+ * agree.
+ */
+int main(int argc, char** argv)
+{
+    size_t count = bench_arg(argc, argv, 1, 4000000);
+    size_t max_threads = bench_arg(argc, argv, 2, bench_cpus());
+    vector_t* vector = vector_new(count);
+    const void** values = (const void**) malloc(count * sizeof(*values));
+    const void** expected = (const void**) malloc(count * sizeof(*expected));
+    if (vector == NULL || values == NULL || expected == NULL) {
+        return 1;
+    }
+
+    int failed = 0;
+    printf("%zu values, %zu cpus\n", count, bench_cpus());
+    printf("pattern         qsort  vector_sort  vector_stable_sort  vector_sort_by_key\n");
+    for (int pattern = 0; pattern < PATTERNS; pattern++) {
+        bench_pattern(pattern, values, count);
+        memcpy(expected, values, count * sizeof(*values));
+        double start = bench_now();
+        qsort(expected, count, sizeof(*expected), compare_qsort);
+        double qsorted = (bench_now() - start) * 1e3;
+
+        double sorted = bench_vector(vector, vector_sort, values, expected, count);
+        double stable = bench_vector(vector, vector_stable_sort, values, expected, count);
+        double by_key = bench_vector(vector, sort_by_key, values, expected, count);
+        failed |= sorted < 0 || stable < 0 || by_key < 0;
+        printf("%-10s  %9.1f  %11.1f  %18.1f  %18.1f\n", pattern_names[pattern], qsorted, sorted, stable, by_key);
+    }
+
+    printf("\nvector_sort_parallel\nthreads");
+    for (int pattern = 0; pattern < PATTERNS; pattern++) {
+        printf("  %10s", pattern_names[pattern]);
+    }
+
+    printf("\n");
+    for (parallel_threads = 1; parallel_threads <= max_threads; parallel_threads *= 2) {
+        printf("%7zu", parallel_threads);
+        for (int pattern = 0; pattern < PATTERNS; pattern++) {
+            bench_pattern(pattern, values, count);
+            memcpy(expected, values, count * sizeof(*values));
+            qsort(expected, count, sizeof(*expected), compare_qsort);
+            double sorted = bench_vector(vector, sort_parallel, values, expected, count);
+            failed |= sorted < 0;
+            printf("  %10.1f", sorted);
+        }
+
+        printf("\n");
+    }
+
+    free(expected);
+    free(values);
+    vector_release(vector);
+    return failed;
+}
@@ -19,6 +19,14 @@ extern "C" {
  */
 binary_heap_t* binary_heap_new(size_t capacity, compare_t compare);
 
+/**
+ * Allocates a new binary heap with the given capacity and compare function,
+ * which is called with `ctx`.
+ * Returns the new heap on success or `NULL` on error.
+ * The heap must be deallocated with `binary_heap_release()`.
+ */
+binary_heap_t* binary_heap_new_ctx(size_t capacity, compare_ctx_t compare, void* ctx);
+
 /**
  * Adds an element to the heap.
  * `value` cannot be `NULL`.
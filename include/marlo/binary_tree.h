@@ -76,6 +76,13 @@ const void* binary_tree_value(const tree_node_t* node);
  */
 int binary_tree_traverse(const binary_tree_t* tree, int order, callback_t on_value);
 
+/**
+ * Traverses the tree in the given order, calling the given callback function
+ * with each value and `ctx`.
+ * Returns 0 on success or -1 on error.
+ */
+int binary_tree_traverse_ctx(const binary_tree_t* tree, int order, callback_ctx_t on_value, void* ctx);
+
 /**
  * Whether the tree is empty.
  * Returns 1 if the tree is empty, 0 otherwise.
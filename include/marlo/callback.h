@@ -4,3 +4,8 @@
  * Callback function.
  */
 typedef void (*callback_t)(const void* value);
+
+/**
+ * Callback function taking the context given along with it.
+ */
+typedef void (*callback_ctx_t)(const void* value, void* ctx);
@@ -0,0 +1,94 @@
+#pragma once
+
+#include "marlo/hash_table.h"
+#include <stddef.h>
+
+/**
+ * Opaque concurrent hash table type.
+ * All functions can be called from any number of threads at the same time,
+ * except for `concurrent_hash_table_release()`.
+ * Lookups don't take any lock, writers only lock the shard the key maps to.
+ * The table is split in 64 shards. Threads waiting for a shard spin with a
+ * growing pause, then yield their processor.
+ * A push that fills its shard copies the whole shard into an array twice as
+ * large while holding the lock, so other writers to that shard wait for the
+ * copy. The old arrays are kept until `concurrent_hash_table_reclaim()` or
+ * `concurrent_hash_table_release()`, since lookups may still be reading them.
+ * They're never larger than the current arrays together.
+ */
+typedef struct concurrent_hash_table_t concurrent_hash_table_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Allocates a new concurrent hash table with the given mode of operation and
+ * capacity.
+ * `mode` must be either `HASH_TABLE_ADDRESS`, `HASH_TABLE_STRING` or
+ * `HASH_TABLE_BYTES` (see `hash_table.h`).
+ * Returns the new table on success or `NULL` on error.
+ * The table must be deallocated with `concurrent_hash_table_release()`.
+ */
+concurrent_hash_table_t* concurrent_hash_table_new(int mode, size_t capacity);
+
+/**
+ * Returns the mode of the table or -1 on error (`NULL` table).
+ */
+int concurrent_hash_table_mode(const concurrent_hash_table_t* table);
+
+/**
+ * Adds a key-value pair to the table.
+ * `key` can only be `NULL` in `HASH_TABLE_ADDRESS` mode.
+ * `value` cannot be `NULL`.
+ * If the value already exists at the given key, it's updated.
+ * Returns 0 on success or -1 on error.
+ */
+int concurrent_hash_table_push(concurrent_hash_table_t* table, const void* key, const void* value);
+
+/**
+ * Returns the value at the given key or `NULL` on error (not found).
+ * Keys removed from the table may still be read by lookups running at the
+ * same time, so they must not be deallocated until those have returned.
+ */
+const void* concurrent_hash_table_at(const concurrent_hash_table_t* table, const void* key);
+
+/**
+ * Whether the table contains a value for the given key.
+ * Returns 1 if the table contains a value for the key, 0 otherwise.
+ */
+int concurrent_hash_table_contains(const concurrent_hash_table_t* table, const void* key);
+
+/**
+ * Removes a key-value pair from the table.
+ * Does nothing if the key doesn't exist within the table.
+ */
+void concurrent_hash_table_remove(concurrent_hash_table_t* table, const void* key);
+
+/**
+ * Removes all key-value pairs from the table.
+ * The table's capacity is not changed.
+ */
+void concurrent_hash_table_clear(concurrent_hash_table_t* table);
+
+/**
+ * Returns the number of key-value pairs in the table.
+ * The result is only a snapshot while other threads are writing.
+ */
+size_t concurrent_hash_table_size(const concurrent_hash_table_t* table);
+
+/**
+ * Deallocates the slot arrays the table outgrew.
+ * Pushes and removals can run at the same time, lookups can't.
+ */
+void concurrent_hash_table_reclaim(concurrent_hash_table_t* table);
+
+/**
+ * Deallocates the given table.
+ * No other thread may be using the table, `table` must not be reused.
+ */
+void concurrent_hash_table_release(concurrent_hash_table_t* table);
+
+#ifdef __cplusplus
+}
+#endif
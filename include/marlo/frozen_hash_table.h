@@ -0,0 +1,111 @@
+#pragma once
+
+#include "marlo/hash_table.h"
+#include <stddef.h>
+
+/**
+ * Opaque frozen hash table type.
+ * Immutable snapshot of a hash table, indexed by a minimal perfect hash: every
+ * lookup is a single probe into a compact array followed by a single key
+ * comparison.
+ * Read-only, so it can be shared by any number of threads.
+ * Frozen tables can be written to a file and mapped back into memory by other
+ * processes, without rebuilding them.
+ */
+typedef struct frozen_hash_table_t frozen_hash_table_t;
+
+/**
+ * Returns the number of bytes the given value takes, so it can be written
+ * along with the table.
+ */
+typedef size_t (*frozen_hash_table_value_size_t)(const void* value, void* ctx);
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Builds a frozen table with the key-value pairs of the given table.
+ * The table must be in either `HASH_TABLE_ADDRESS`, `HASH_TABLE_STRING` or
+ * `HASH_TABLE_BYTES` mode. String and bytes keys are copied, so the frozen
+ * table doesn't depend on the original table nor its keys.
+ * Building is linear-ish in the number of pairs, lookups are meant to make up
+ * for it.
+ * Returns the new frozen table on success or `NULL` on error.
+ * The frozen table must be deallocated with `frozen_hash_table_release()`.
+ */
+frozen_hash_table_t* hash_table_freeze(const hash_table_t* table);
+
+/**
+ * Writes the given table to a file at `path`, overwriting it.
+ * The file only holds offsets, string and bytes keys are stored inline, and
+ * so are values: each value is copied as the `value_size()` bytes it points
+ * to, aligned to 8 bytes and followed by a null byte. Values are taken for
+ * null-terminated strings if `value_size` is `NULL`.
+ * Address mode keys are stored as integers, they're only meaningful to other
+ * processes if they aren't actual addresses.
+ * The file is meant to be mapped on the machine that wrote it (integers are
+ * stored in native byte order).
+ * Returns 0 on success or -1 on error.
+ */
+int frozen_hash_table_write(const frozen_hash_table_t* table, const char* path, frozen_hash_table_value_size_t value_size, void* ctx);
+
+/**
+ * Freezes the given table and writes it to a file at `path`, see
+ * `hash_table_freeze()` and `frozen_hash_table_write()`.
+ * Returns 0 on success or -1 on error.
+ */
+int hash_table_write(const hash_table_t* table, const char* path, frozen_hash_table_value_size_t value_size, void* ctx);
+
+/**
+ * Maps a file written by `frozen_hash_table_write()` into memory, read-only.
+ * Nothing is copied nor rebuilt, pages are loaded as lookups touch them and
+ * are shared with every other process mapping the same file.
+ * Keys and values returned by the table point into the mapping, they're
+ * valid until the table is released.
+ * The file must not be modified while mapped.
+ * Keys and values of a corrupt file that don't fit in it are treated as
+ * missing, so they're never read past the end of the mapping.
+ * Returns the mapped table on success or `NULL` on error (including invalid
+ * files).
+ * The table must be deallocated with `frozen_hash_table_release()`.
+ */
+frozen_hash_table_t* frozen_hash_table_map(const char* path);
+
+/**
+ * Returns the mode of the table or -1 on error (`NULL` table).
+ */
+int frozen_hash_table_mode(const frozen_hash_table_t* table);
+
+/**
+ * Returns the value at the given key or `NULL` on error (not found).
+ */
+const void* frozen_hash_table_at(const frozen_hash_table_t* table, const void* key);
+
+/**
+ * Whether the table contains a value for the given key.
+ * Returns 1 if the table contains a value for the key, 0 otherwise.
+ */
+int frozen_hash_table_contains(const frozen_hash_table_t* table, const void* key);
+
+/**
+ * Returns the number of key-value pairs in the table.
+ */
+size_t frozen_hash_table_size(const frozen_hash_table_t* table);
+
+/**
+ * Returns the key-value pair at the given index (in no particular order) or a
+ * `NULL`ed/zero struct on error (index out of bounds).
+ * Along with `frozen_hash_table_size()`, this allows iterating the table.
+ */
+hash_table_item_t frozen_hash_table_item(const frozen_hash_table_t* table, size_t index);
+
+/**
+ * Deallocates the given table.
+ * `table` must not be reused.
+ */
+void frozen_hash_table_release(frozen_hash_table_t* table);
+
+#ifdef __cplusplus
+}
+#endif
@@ -1,5 +1,6 @@
 #pragma once
 
+#include "marlo/hash_table.h"
 #include <stddef.h>
 
 /**
@@ -21,16 +22,36 @@ extern "C" {
 #endif
 
 /**
- * Allocates a new hash set with the given capacity.
+ * Allocates a new hash set with the given capacity, whose elements are
+ * compared by address.
+ * `capacity` is rounded up to a power of two.
  * Returns the new set on success or `NULL` on error.
  * The set must be deallocated with `hash_set_release()`.
  */
 hash_set_t* hash_set_new(size_t capacity);
 
+/**
+ * Allocates a new hash set with the given mode of operation and capacity.
+ * `mode` must be either `HASH_TABLE_ADDRESS` or `HASH_TABLE_STRING` (see
+ * `hash_table.h`), in string mode elements are hashed and compared by
+ * contents.
+ * Only a pointer to each element is stored, so strings must outlive the set.
+ * `capacity` is rounded up to a power of two.
+ * Returns the new set on success or `NULL` on error.
+ * The set must be deallocated with `hash_set_release()`.
+ */
+hash_set_t* hash_set_new_mode(int mode, size_t capacity);
+
+/**
+ * Returns the mode of the set or -1 on error (`NULL` set).
+ */
+int hash_set_mode(const hash_set_t* set);
+
 /**
  * Adds an element to the set.
  * `value` cannot be `NULL`.
- * If the value already exists within the set, it's updated.
+ * Does nothing if the value already exists within the set, in string mode
+ * the string added first is the one kept.
  * Returns 0 on success or -1 on error.
  */
 int hash_set_push(hash_set_t* set, const void* value);
@@ -50,6 +71,8 @@ int hash_set_contains(const hash_set_t* set, const void* value);
 /**
  * Returns an iterator pointing to the beginning of the given set or a
  * `NULL`ed/zero struct on error (empty set).
+ * Elements are visited in no particular order, iterators are invalidated by
+ * adding or removing elements.
  */
 hash_set_iterator_t hash_set_begin(const hash_set_t* set);
 
@@ -76,6 +99,39 @@ const void* hash_set_value(hash_set_iterator_t iter);
  */
 void hash_set_remove(hash_set_t* set, const void* value);
 
+/**
+ * Returns a new set holding the elements of both sets or `NULL` on error
+ * (including sets of different modes).
+ * The new set is a copy of the larger set, sized for both, to which the
+ * elements of the smaller one are added.
+ * The new set must be deallocated with `hash_set_release()`.
+ */
+hash_set_t* hash_set_union(const hash_set_t* set, const hash_set_t* other);
+
+/**
+ * Returns a new set holding the elements found in both sets or `NULL` on
+ * error (including sets of different modes).
+ * Only the smaller set is iterated.
+ * The new set must be deallocated with `hash_set_release()`.
+ */
+hash_set_t* hash_set_intersect(const hash_set_t* set, const hash_set_t* other);
+
+/**
+ * Returns a new set holding the elements of `set` not found in `other` or
+ * `NULL` on error (including sets of different modes).
+ * Only the smaller set is iterated, the elements of `other` being removed
+ * from a copy of `set` if `other` is the smaller one.
+ * The new set must be deallocated with `hash_set_release()`.
+ */
+hash_set_t* hash_set_difference(const hash_set_t* set, const hash_set_t* other);
+
+/**
+ * Grows the set so it can hold at least `size` elements without growing
+ * again.
+ * Returns 0 on success or -1 on error.
+ */
+int hash_set_reserve(hash_set_t* set, size_t size);
+
 /**
  * Removes all elements from the set.
  * The set's capacity is not changed.
@@ -1,9 +1,14 @@
 #pragma once
 
 #include <stddef.h>
+#include <stdint.h>
 
 /**
  * Opaque hash table type.
+ * Key-value pairs are kept in insertion order in a dense array, indexed by an
+ * open addressing table, so iteration only visits the pairs themselves.
+ * Small tables (up to 8 pairs) keep their pairs inside the table object and
+ * search them linearly, so they need no allocation besides the table.
  */
 typedef struct hash_table_t hash_table_t;
 
@@ -19,6 +24,128 @@ typedef struct hash_table_t hash_table_t;
  */
 #define HASH_TABLE_STRING 2
 
+/**
+ * Bytes mode.
+ * Keys are pointers to `hash_table_bytes_t` descriptors and are compared by
+ * length and contents.
+ */
+#define HASH_TABLE_BYTES 3
+
+/**
+ * Custom mode.
+ * Keys are hashed and compared with user functions, see
+ * `hash_table_new_custom()`.
+ */
+#define HASH_TABLE_CUSTOM 4
+
+/**
+ * Incremental rehashing flag, can be combined with any mode.
+ * When the table grows, the old slots are migrated a few at a time by each
+ * push/remove instead of all at once, bounding the latency of a single call.
+ * Removed pairs are compacted away a few at a time by pushes as well (and by
+ * removals in `HASH_TABLE_AUTO_SHRINK` mode). Growing still reallocates the
+ * pairs array and frees the drained slots in single calls to the allocator.
+ */
+#define HASH_TABLE_INCREMENTAL 0x100
+
+/**
+ * Automatic shrinking flag, can be combined with any mode.
+ * When removals bring the load factor below 1/8, the table is shrunk to the
+ * smallest capacity that fits its entries, giving memory back after churn.
+ */
+#define HASH_TABLE_AUTO_SHRINK 0x200
+
+/**
+ * Key owning flag, can be combined with `HASH_TABLE_STRING` and
+ * `HASH_TABLE_BYTES` modes.
+ * Keys are copied into memory owned by the table, so callers don't need to
+ * keep them alive. The copies are null-terminated, packed together and freed
+ * in large chunks by `hash_table_clear()` and `hash_table_release()`, or
+ * once every key in a chunk has been removed.
+ * Keys returned by the table are valid until they're removed, a chunk
+ * holding a single live key is kept whole.
+ */
+#define HASH_TABLE_OWN_KEYS 0x400
+
+/**
+ * Keyed hashing flag, can be combined with `HASH_TABLE_STRING` and
+ * `HASH_TABLE_BYTES` modes.
+ * Keys are hashed with SipHash-1-3 and a random per-table seed, so colliding
+ * keys can't be crafted without knowing the seed.
+ * Tables without it switch to keyed hashing on their own as soon as a key
+ * lands too far from its home slot, so untrusted keys can't degrade lookups
+ * while trusted ones keep the faster default hash.
+ */
+#define HASH_TABLE_KEYED 0x800
+
+/**
+ * Length-delimited key for `HASH_TABLE_BYTES` mode.
+ * The descriptor only needs to live for the duration of the call, the bytes
+ * it points to must outlive the entry though (the table doesn't copy them).
+ */
+typedef struct hash_table_bytes_t {
+    const void* data;
+    size_t size;
+} hash_table_bytes_t;
+
+/**
+ * Custom mode hash function.
+ */
+typedef uint64_t (*hash_table_hash_t)(const void* key, void* ctx);
+
+/**
+ * Custom mode equality function.
+ * Returns non-zero if both keys are equal, 0 otherwise.
+ */
+typedef int (*hash_table_equals_t)(const void* key, const void* other, void* ctx);
+
+/**
+ * Update function for `hash_table_update_with()`.
+ * `value` is the current value at `key` or `NULL` if there's none.
+ * Returns the new value or `NULL` to remove the key.
+ */
+typedef const void* (*hash_table_update_t)(const void* key, const void* value, void* ctx);
+
+/**
+ * Predicate for `hash_table_retain()`.
+ * Returns non-zero to keep the key-value pair, 0 to remove it.
+ */
+typedef int (*hash_table_predicate_t)(const void* key, const void* value, void* ctx);
+
+/**
+ * Number of probe distances tracked by `hash_table_stats_t`.
+ */
+#define HASH_TABLE_STATS_PROBES 16
+
+/**
+ * Hash table statistics, see `hash_table_stats()`.
+ * `probes[i]` is the number of keys stored `i` slots away from their home
+ * slot, the last counter includes every longer distance. `max_probe` and
+ * `mean_probe` are the longest and average distances, a good hash keeps them
+ * small.
+ * `removed` is the number of removed entries waiting to be compacted.
+ * `rehashes` is the number of times the index was rebuilt (grown, shrunk or
+ * compacted) and `rehash_time` the time spent doing so in seconds,
+ * incremental migration included.
+ * `index_bytes`, `entry_bytes` and `key_bytes` are the bytes allocated for
+ * the index slots, the entries and the owned keys, `total_bytes` adds the
+ * table itself (which holds the entries of small tables).
+ */
+typedef struct hash_table_stats_t {
+    size_t size;
+    size_t capacity;
+    size_t removed;
+    size_t probes[HASH_TABLE_STATS_PROBES];
+    size_t max_probe;
+    double mean_probe;
+    size_t rehashes;
+    double rehash_time;
+    size_t index_bytes;
+    size_t entry_bytes;
+    size_t key_bytes;
+    size_t total_bytes;
+} hash_table_stats_t;
+
 /**
  * Hash table iterator type.
  */
@@ -30,10 +157,13 @@ typedef struct hash_table_iterator_t {
 
 /**
  * Hash table key-value pair.
+ * `key_size` is the length of the key in string and bytes modes (in which case
+ * `key` points to the key bytes), 0 otherwise.
  */
 typedef struct hash_table_item_t {
     const void* key;
     const void* value;
+    size_t key_size;
 } hash_table_item_t;
 
 #ifdef __cplusplus
@@ -42,17 +172,36 @@ extern "C" {
 
 /**
  * Allocates a new hash table with the given mode of operation and capacity.
- * `mode` must be either `HASH_TABLE_ADDRESS` or `HASH_TABLE_STRING`.
+ * `mode` must be either `HASH_TABLE_ADDRESS`, `HASH_TABLE_STRING` or
+ * `HASH_TABLE_BYTES`, optionally combined with the `HASH_TABLE_INCREMENTAL`,
+ * `HASH_TABLE_AUTO_SHRINK`, `HASH_TABLE_OWN_KEYS` and `HASH_TABLE_KEYED` flags.
+ * `capacity` is rounded up to a power of two, tables of capacity 8 or less
+ * start small (see `hash_table_t`).
  * Returns the new table on success or `NULL` on error.
  * The table must be deallocated with `hash_table_release()`.
  */
 hash_table_t* hash_table_new(int mode, size_t capacity);
 
 /**
- * Returns the mode of the table or -1 on error (`NULL` table).
+ * Allocates a new hash table in `HASH_TABLE_CUSTOM` mode.
+ * `flags` can be 0, `HASH_TABLE_INCREMENTAL` and/or `HASH_TABLE_AUTO_SHRINK`.
+ * Keys are hashed with `hash` and compared with `equals`, both receive `ctx`.
+ * Keys that compare equal must hash equal.
+ * Returns the new table on success or `NULL` on error.
+ * The table must be deallocated with `hash_table_release()`.
+ */
+hash_table_t* hash_table_new_custom(int flags, size_t capacity, hash_table_hash_t hash, hash_table_equals_t equals, void* ctx);
+
+/**
+ * Returns the mode of the table (without flags) or -1 on error (`NULL` table).
  */
 int hash_table_mode(const hash_table_t* table);
 
+/**
+ * Returns the flags the table was created with or -1 on error (`NULL` table).
+ */
+int hash_table_flags(const hash_table_t* table);
+
 /**
  * Whether the table is in address mode.
  * Returns 1 if the table's mode is `HASH_TABLE_ADDRESS`, 0 otherwise.
@@ -65,20 +214,85 @@ int hash_table_is_address(const hash_table_t* table);
  */
 int hash_table_is_string(const hash_table_t* table);
 
+/**
+ * Whether the table is in bytes mode.
+ * Returns 1 if the table's mode is `HASH_TABLE_BYTES`, 0 otherwise.
+ */
+int hash_table_is_bytes(const hash_table_t* table);
+
+/**
+ * Whether the table is in custom mode.
+ * Returns 1 if the table's mode is `HASH_TABLE_CUSTOM`, 0 otherwise.
+ */
+int hash_table_is_custom(const hash_table_t* table);
+
+/**
+ * Whether the table hashes its keys with a random seed, either because it
+ * was created with `HASH_TABLE_KEYED` or because it switched to it.
+ * Returns 1 if the table is keyed, 0 otherwise.
+ */
+int hash_table_is_keyed(const hash_table_t* table);
+
+/**
+ * Whether an incremental rehash is in progress.
+ * Returns 1 if old slots are still being migrated, 0 otherwise.
+ */
+int hash_table_is_rehashing(const hash_table_t* table);
+
 /**
  * Adds a key-value pair to the table.
- * `key` can only be `NULL` in `HASH_TABLE_ADDRESS` mode.
+ * `key` can only be `NULL` in `HASH_TABLE_ADDRESS` and `HASH_TABLE_CUSTOM`
+ * modes.
  * `value` cannot be `NULL`.
  * If the value already exists at the given key, it's updated.
  * Returns 0 on success or -1 on error.
  */
 int hash_table_push(hash_table_t* table, const void* key, const void* value);
 
+/**
+ * Adds `count` key-value pairs to the table, as if by `hash_table_push()`.
+ * Keys are hashed and their slots prefetched in small batches, so the cache
+ * misses of a batch overlap instead of being paid one after the other.
+ * Returns 0 on success or -1 on error, pairs before the failing one are kept.
+ */
+int hash_table_push_many(hash_table_t* table, const void* const* keys, const void* const* values, size_t count);
+
+/**
+ * Returns the value slot at the given key, adding `value` at the key first if
+ * the table doesn't contain it, or `NULL` on error.
+ * The key is hashed and probed once, unlike `hash_table_at()` followed by
+ * `hash_table_push()`.
+ * `value` cannot be `NULL`, neither can be the values written to the slot.
+ * The slot is only valid until the table is modified.
+ * If `inserted` isn't `NULL`, it's set to 1 if the key was added, 0 otherwise.
+ */
+const void** hash_table_get_or_insert(hash_table_t* table, const void* key, const void* value, int* inserted);
+
+/**
+ * Replaces the value at the given key by the result of `update`, which gets
+ * the current value or `NULL` if there's none.
+ * The key is added if there was no value and removed if `update` returns
+ * `NULL`. Either way it's hashed and compared against other keys only while
+ * looking it up, the index is then updated through the cached hash.
+ * `update` must not modify the table.
+ * Returns 0 on success or -1 on error.
+ */
+int hash_table_update_with(hash_table_t* table, const void* key, hash_table_update_t update, void* ctx);
+
 /**
  * Returns the value at the given key or `NULL` on error (not found).
  */
 const void* hash_table_at(const hash_table_t* table, const void* key);
 
+/**
+ * Looks up `count` keys at once, storing the value of each key (or `NULL` if
+ * not found) at the same index of `values`.
+ * Keys are hashed and their slots prefetched in small batches, so the cache
+ * misses of a batch overlap instead of being paid one after the other.
+ * Returns the number of keys found.
+ */
+size_t hash_table_at_many(const hash_table_t* table, const void* const* keys, size_t count, const void** values);
+
 /**
  * Whether the table is empty.
  * Returns 1 if the table is empty, 0 otherwise.
@@ -94,6 +308,11 @@ int hash_table_contains(const hash_table_t* table, const void* key);
 /**
  * Returns an iterator pointing to the beginning of the given table or a
  * `NULL`ed/zero struct on error (empty table).
+ * Items are visited in insertion order, updating the value of a key doesn't
+ * change its position.
+ * Iterators stay valid when removing keys (the current one included), except
+ * in `HASH_TABLE_AUTO_SHRINK` mode, but not when pushing new ones.
+ * `hash_table_erase()` can remove the current item in every mode.
  */
 hash_table_iterator_t hash_table_begin(const hash_table_t* table);
 
@@ -119,12 +338,34 @@ hash_table_item_t hash_table_item(hash_table_iterator_t iter);
 /**
  * Removes a key-value pair from the table.
  * Does nothing if the key doesn't exist within the table.
+ * With `HASH_TABLE_AUTO_SHRINK` the table may shrink afterwards.
  */
 void hash_table_remove(hash_table_t* table, const void* key);
 
+/**
+ * Removes the key-value pair at the given iterator from the table.
+ * Returns an iterator pointing to the item after the removed one or a
+ * `NULL`ed/zero struct on error (bad iterator, no next).
+ * The table never shrinks here, even in `HASH_TABLE_AUTO_SHRINK` mode, so
+ * iterating can go on with the returned iterator.
+ */
+hash_table_iterator_t hash_table_erase(hash_table_t* table, hash_table_iterator_t iter);
+
+/**
+ * Removes every key-value pair for which `predicate` returns 0, in a single
+ * pass over the table.
+ * Keys are neither hashed nor compared, each removal only walks the index
+ * from the cached hash of its entry.
+ * `predicate` must not modify the table.
+ * With `HASH_TABLE_AUTO_SHRINK` the table may shrink afterwards.
+ * Returns the number of key-value pairs removed.
+ */
+size_t hash_table_retain(hash_table_t* table, hash_table_predicate_t predicate, void* ctx);
+
 /**
  * Removes all key-value pairs from the table.
- * The table's capacity is not changed.
+ * The table's capacity is not changed, so it's done in constant time, the
+ * memory is kept for the next pairs (see `hash_table_shrink_to_fit()`).
  */
 void hash_table_clear(hash_table_t* table);
 
@@ -134,7 +375,8 @@ void hash_table_clear(hash_table_t* table);
 size_t hash_table_size(const hash_table_t* table);
 
 /**
- * Returns the capacity of the table.
+ * Returns the capacity of the table, the number of pairs held inline for
+ * small tables.
  */
 size_t hash_table_capacity(const hash_table_t* table);
 
@@ -143,6 +385,31 @@ size_t hash_table_capacity(const hash_table_t* table);
  */
 float hash_table_load_factor(const hash_table_t* table);
 
+/**
+ * Fills `stats` with statistics about the given table.
+ * Walks the whole index, so it takes time proportional to the capacity.
+ * Returns 0 on success or -1 on error.
+ */
+int hash_table_stats(const hash_table_t* table, hash_table_stats_t* stats);
+
+/**
+ * Grows the table so it can hold at least `size` key-value pairs without
+ * rehashing, taking the max load factor into account.
+ * Does nothing if the table is already large enough.
+ * Returns 0 on success or -1 on error.
+ */
+int hash_table_reserve(hash_table_t* table, size_t size);
+
+/**
+ * Shrinks the table to the smallest capacity that holds its key-value pairs.
+ * Tables holding 8 pairs or less release their slots altogether and keep the
+ * pairs inline again, as small tables do (see `hash_table_t`).
+ * The space left by removed pairs is reclaimed and any pending incremental
+ * rehash is completed.
+ * Returns 0 on success or -1 on error.
+ */
+int hash_table_shrink_to_fit(hash_table_t* table);
+
 /**
  * Deallocates the given table.
  * `table` must not be reused.
@@ -1,6 +1,22 @@
 #pragma once
 
+#include <stdint.h>
+
 /**
  * Sorting compare function.
  */
 typedef int (*compare_t)(const void* one, const void* other);
+
+/**
+ * Sorting compare function taking the context given along with it.
+ */
+typedef int (*compare_ctx_t)(const void* one, const void* other, void* ctx);
+
+/**
+ * Sorting key function, returning the key of the given value, values being
+ * sorted in increasing order of their keys.
+ * Signed integers map to keys in the same order by flipping their sign bit,
+ * IEEE 754 doubles by flipping their sign bit if it's clear and all their
+ * bits if it's set.
+ */
+typedef uint64_t (*sort_key_t)(const void* value, void* ctx);
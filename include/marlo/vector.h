@@ -45,6 +45,13 @@ const void* vector_at(const vector_t* vector, size_t pos);
  */
 int vector_foreach(const vector_t* vector, callback_t on_value);
 
+/**
+ * Iterates through all the elements of the vector, calling the given
+ * callback function with each element/value and `ctx`.
+ * Returns 0 on success or -1 on error (invalid arguments).
+ */
+int vector_foreach_ctx(const vector_t* vector, callback_ctx_t on_value, void* ctx);
+
 /**
  * Whether the vector is empty.
  * Returns 1 if the vector is empty, 0 otherwise.
@@ -75,10 +82,52 @@ size_t vector_capacity(const vector_t* vector);
 
 /**
  * Sorts the vector using the given compare function.
+ * Runs in O(n log n) time whatever the input, sorted and reversed vectors
+ * included, the relative order of equal elements isn't kept.
  * Returns 0 on success or -1 on error (invalid arguments).
  */
 int vector_sort(vector_t* vector, compare_t compare);
 
+/**
+ * Sorts the vector like `vector_sort()`, calling the given compare function
+ * with `ctx`.
+ * Returns 0 on success or -1 on error (invalid arguments).
+ */
+int vector_sort_ctx(vector_t* vector, compare_ctx_t compare, void* ctx);
+
+/**
+ * Sorts the vector using the given compare function, keeping equal
+ * elements in their original order.
+ * Takes advantage of the already sorted runs of elements, so sorted,
+ * reversed or nearly sorted vectors sort in close to linear time, and
+ * O(n log n) time otherwise, using temporary storage for at most half the
+ * elements.
+ * Returns 0 on success or -1 on error (invalid arguments or out of memory),
+ * in which case the order of the elements is unspecified.
+ */
+int vector_stable_sort(vector_t* vector, compare_t compare);
+
+/**
+ * Sorts the vector in increasing order of the keys the given key function
+ * returns for its elements, keeping equal keys in their original order.
+ * `key` is called once per element and the keys radix sorted, in O(n) time
+ * and without comparisons, using temporary storage for twice as many
+ * (key, element) pairs as there are elements.
+ * Returns 0 on success or -1 on error (invalid arguments or out of memory).
+ */
+int vector_sort_by_key(vector_t* vector, sort_key_t key, void* ctx);
+
+/**
+ * Sorts the given vector like `vector_sort()`, on up to `threads` threads,
+ * one per online processor if `threads` is 0.
+ * Vectors of fewer than a few tens of thousands of elements per thread are
+ * sorted on fewer threads, down to the calling one alone, as they are when
+ * the temporary copy of the elements it needs can't be allocated.
+ * `compare` is called from several threads at once and must be thread-safe.
+ * Returns 0 on success or -1 on error (invalid arguments).
+ */
+int vector_sort_parallel(vector_t* vector, compare_t compare, size_t threads);
+
 /**
  * Deallocates the given vector.
  * `vector` must not be reused.
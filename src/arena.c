@@ -0,0 +1,138 @@
+#include "arena.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#define MIN_CHUNK_SIZE 4096
+#define MAX_CHUNK_SIZE (1024 * 1024)
+
+void arena_init(arena_t* arena)
+{
+    arena->chunks = NULL;
+    arena->used = 0;
+}
+
+void* arena_alloc(arena_t* arena, size_t size)
+{
+    arena_chunk_t* chunk = arena->chunks;
+    if (chunk == NULL || chunk->capacity - chunk->used < size) {
+        size_t capacity = chunk != NULL ? chunk->capacity * 2 : MIN_CHUNK_SIZE;
+        if (capacity > MAX_CHUNK_SIZE) {
+            capacity = MAX_CHUNK_SIZE;
+        }
+
+        if (capacity < size) {
+            capacity = size;
+        }
+
+        if (capacity > SIZE_MAX - sizeof(arena_chunk_t)) {
+            return NULL;
+        }
+
+        chunk = (arena_chunk_t*) malloc(sizeof(arena_chunk_t) + capacity);
+        if (chunk == NULL) {
+            return NULL;
+        }
+
+        chunk->next = arena->chunks;
+        chunk->capacity = capacity;
+        chunk->used = 0;
+        arena->chunks = chunk;
+    }
+
+    void* data = &chunk->data[chunk->used];
+    chunk->used += size;
+    arena->used += size;
+    return data;
+}
+
+size_t arena_bytes(const arena_t* arena)
+{
+    size_t bytes = 0;
+    for (const arena_chunk_t* chunk = arena->chunks; chunk != NULL; chunk = chunk->next) {
+        bytes += sizeof(arena_chunk_t) + chunk->capacity;
+    }
+
+    return bytes;
+}
+
+/**
+ * Whether `data` was carved out of the given chunk.
+ */
+static int arena_chunk_holds(const arena_chunk_t* chunk, const void* data)
+{
+    uintptr_t address = (uintptr_t) data;
+    uintptr_t begin = (uintptr_t) chunk->data;
+    return address >= begin && address - begin < chunk->used;
+}
+
+void arena_trim(arena_t* arena, arena_next_t next, void* ctx)
+{
+    arena_chunk_t* current = arena->chunks;
+    if (current == NULL || current->next == NULL) {
+        return;
+    }
+
+    arena_chunk_t* oldest = NULL;
+    arena_chunk_t* chunk = current->next;
+    while (chunk != NULL) {
+        arena_chunk_t* tmp = chunk->next;
+        chunk->next = oldest;
+        oldest = chunk;
+        chunk = tmp;
+    }
+
+    arena_chunk_t* kept = NULL;
+    const void* data = next(ctx);
+    while (oldest != NULL) {
+        chunk = oldest;
+        oldest = oldest->next;
+
+        int live = 0;
+        while (data != NULL && arena_chunk_holds(chunk, data)) {
+            live = 1;
+            data = next(ctx);
+        }
+
+        if (live) {
+            chunk->next = kept;
+            kept = chunk;
+        } else {
+            arena->used -= chunk->used;
+            free(chunk);
+        }
+    }
+
+    current->next = kept;
+}
+
+void arena_reset(arena_t* arena)
+{
+    arena_chunk_t* chunk = arena->chunks;
+    if (chunk != NULL) {
+        arena_chunk_t* next = chunk->next;
+        while (next != NULL) {
+            arena_chunk_t* tmp = next->next;
+            free(next);
+            next = tmp;
+        }
+
+        chunk->next = NULL;
+        chunk->used = 0;
+    }
+
+    arena->used = 0;
+}
+
+void arena_release(arena_t* arena)
+{
+    arena_chunk_t* chunk = arena->chunks;
+    while (chunk != NULL) {
+        arena_chunk_t* next = chunk->next;
+        free(chunk);
+        chunk = next;
+    }
+
+    arena->chunks = NULL;
+    arena->used = 0;
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <stddef.h>
+
+/**
+ * Arena chunk, allocations are carved out of `data` one after the other.
+ */
+typedef struct arena_chunk_t {
+    struct arena_chunk_t* next;
+    size_t capacity;
+    size_t used;
+    unsigned char data[];
+} arena_chunk_t;
+
+/**
+ * Bump allocator for byte strings (no alignment is guaranteed).
+ * Memory is only given back all at once, with `arena_reset()` or
+ * `arena_release()`.
+ * `chunks` is the current chunk, followed by the older ones.
+ * `used` is the number of bytes handed out since the last reset.
+ */
+typedef struct arena_t {
+    arena_chunk_t* chunks;
+    size_t used;
+} arena_t;
+
+/**
+ * Allocation walker for `arena_trim()`, returns the next allocation still in
+ * use or `NULL` once there are no more.
+ */
+typedef const void* (*arena_next_t)(void* ctx);
+
+/**
+ * Initializes an empty arena, nothing is allocated until needed.
+ */
+void arena_init(arena_t* arena);
+
+/**
+ * Allocates `size` bytes from the arena.
+ * Returns the bytes on success or `NULL` on error.
+ */
+void* arena_alloc(arena_t* arena, size_t size);
+
+/**
+ * Returns the number of bytes allocated by the arena, chunk headers and
+ * unused space included.
+ */
+size_t arena_bytes(const arena_t* arena);
+
+/**
+ * Deallocates the chunks older than the current one that hold none of the
+ * allocations still in use, without moving any of them.
+ * `next` is called with `ctx` to walk these allocations, which must come in
+ * the order they were made.
+ */
+void arena_trim(arena_t* arena, arena_next_t next, void* ctx);
+
+/**
+ * Gives back every allocation at once.
+ * Only the current chunk is kept, to be reused.
+ */
+void arena_reset(arena_t* arena);
+
+/**
+ * Deallocates every chunk, the arena is left empty.
+ */
+void arena_release(arena_t* arena);
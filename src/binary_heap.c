@@ -7,16 +7,14 @@
 struct binary_heap_t {
     const void** values;
     compare_t compare;
+    compare_ctx_t compare_ctx;
+    void* ctx;
     size_t capacity;
     size_t size;
 };
 
-binary_heap_t* binary_heap_new(size_t capacity, compare_t compare)
+static binary_heap_t* binary_heap_new_impl(size_t capacity, compare_t compare, compare_ctx_t compare_ctx, void* ctx)
 {
-    if (compare == NULL) {
-        return NULL;
-    }
-
     binary_heap_t* heap = (binary_heap_t*) malloc(sizeof(binary_heap_t));
     if (heap == NULL) {
         return NULL;
@@ -24,6 +22,8 @@ binary_heap_t* binary_heap_new(size_t capacity, compare_t compare)
 
     heap->values = NULL;
     heap->compare = compare;
+    heap->compare_ctx = compare_ctx;
+    heap->ctx = ctx;
     heap->capacity = capacity;
     heap->size = 0;
 
@@ -44,6 +44,37 @@ binary_heap_t* binary_heap_new(size_t capacity, compare_t compare)
     return heap;
 }
 
+binary_heap_t* binary_heap_new(size_t capacity, compare_t compare)
+{
+    if (compare == NULL) {
+        return NULL;
+    }
+
+    return binary_heap_new_impl(capacity, compare, NULL, NULL);
+}
+
+binary_heap_t* binary_heap_new_ctx(size_t capacity, compare_ctx_t compare, void* ctx)
+{
+    if (compare == NULL) {
+        return NULL;
+    }
+
+    return binary_heap_new_impl(capacity, NULL, compare, ctx);
+}
+
+/**
+ * Compares two values with the heap's compare function, whichever kind it
+ * is, a branch that always goes the same way for a given heap.
+ */
+static int binary_heap_compare(const binary_heap_t* heap, const void* one, const void* other)
+{
+    if (heap->compare != NULL) {
+        return heap->compare(one, other);
+    }
+
+    return heap->compare_ctx(one, other, heap->ctx);
+}
+
 static int binary_heap_resize(binary_heap_t* heap)
 {
     size_t new_capacity = heap->capacity > 0 ? heap->capacity * RESIZE_FACTOR : 1;
@@ -90,7 +121,7 @@ int binary_heap_push(binary_heap_t* heap, const void* value)
     size_t i = heap->size;
     while (i > 0) {
         size_t parent = (i - 1) / 2;
-        if (heap->compare(heap->values[parent], heap->values[i]) < 0) {
+        if (binary_heap_compare(heap, heap->values[parent], heap->values[i]) < 0) {
             break;
         }
 
@@ -121,8 +152,8 @@ const void* binary_heap_pop(binary_heap_t* heap)
         }
 
         size_t right = left + 1;
-        size_t child = !(right < heap->size) || heap->compare(heap->values[left], heap->values[right]) < 0 ? left : right;
-        if (heap->compare(heap->values[i], heap->values[child]) < 0) {
+        size_t child = !(right < heap->size) || binary_heap_compare(heap, heap->values[left], heap->values[right]) < 0 ? left : right;
+        if (binary_heap_compare(heap, heap->values[i], heap->values[child]) < 0) {
             break;
         }
 
@@ -147,7 +147,25 @@ const void* binary_tree_value(const tree_node_t* node)
     return node != NULL ? node->value : NULL;
 }
 
-static int binary_tree_traverse_in_order(const binary_tree_t* tree, callback_t on_value)
+/**
+ * Callback of a traversal, taking a context or not.
+ */
+typedef struct binary_tree_callback_t {
+    callback_t on_value;
+    callback_ctx_t on_value_ctx;
+    void* ctx;
+} binary_tree_callback_t;
+
+static void binary_tree_visit(const binary_tree_callback_t* callback, const void* value)
+{
+    if (callback->on_value != NULL) {
+        callback->on_value(value);
+    } else {
+        callback->on_value_ctx(value, callback->ctx);
+    }
+}
+
+static int binary_tree_traverse_in_order(const binary_tree_t* tree, const binary_tree_callback_t* callback)
 {
     stack_t* stack = stack_new(0);
     if (stack == NULL) {
@@ -167,7 +185,7 @@ static int binary_tree_traverse_in_order(const binary_tree_t* tree, callback_t o
         }
 
         iter = (tree_node_t*) stack_pop(stack);
-        on_value(iter->value);
+        binary_tree_visit(callback, iter->value);
         iter = iter->right;
     }
 
@@ -175,7 +193,7 @@ static int binary_tree_traverse_in_order(const binary_tree_t* tree, callback_t o
     return 0;
 }
 
-static int binary_tree_traverse_pre_order(const binary_tree_t* tree, callback_t on_value)
+static int binary_tree_traverse_pre_order(const binary_tree_t* tree, const binary_tree_callback_t* callback)
 {
     stack_t* stack = stack_new(0);
     if (stack == NULL) {
@@ -185,7 +203,7 @@ static int binary_tree_traverse_pre_order(const binary_tree_t* tree, callback_t
     tree_node_t* iter = tree->root;
     while (iter != NULL || !stack_is_empty(stack)) {
         while (iter != NULL) {
-            on_value(iter->value);
+            binary_tree_visit(callback, iter->value);
             int error = stack_push(stack, iter);
             if (error == -1) {
                 stack_release(stack);
@@ -203,7 +221,7 @@ static int binary_tree_traverse_pre_order(const binary_tree_t* tree, callback_t
     return 0;
 }
 
-static int binary_tree_traverse_post_order(const binary_tree_t* tree, callback_t on_value)
+static int binary_tree_traverse_post_order(const binary_tree_t* tree, const binary_tree_callback_t* callback)
 {
     stack_t* stack = stack_new(0);
     if (stack == NULL) {
@@ -228,7 +246,7 @@ static int binary_tree_traverse_post_order(const binary_tree_t* tree, callback_t
             iter = iter->right;
         } else {
             last = iter;
-            on_value(iter->value);
+            binary_tree_visit(callback, iter->value);
             stack_pop(stack);
             if (stack_is_empty(stack)) {
                 break;
@@ -243,7 +261,7 @@ static int binary_tree_traverse_post_order(const binary_tree_t* tree, callback_t
     return 0;
 }
 
-static int binary_tree_traverse_level_order(const binary_tree_t* tree, callback_t on_value)
+static int binary_tree_traverse_level_order(const binary_tree_t* tree, const binary_tree_callback_t* callback)
 {
     queue_t* queue = queue_new(0);
     if (queue == NULL) {
@@ -260,7 +278,7 @@ static int binary_tree_traverse_level_order(const binary_tree_t* tree, callback_
 
     while (!queue_is_empty(queue)) {
         tree_node_t* node = (tree_node_t*) queue_pop(queue);
-        on_value(node->value);
+        binary_tree_visit(callback, node->value);
 
         if (node->left != NULL) {
             int error = queue_push(queue, node->left);
@@ -283,21 +301,17 @@ static int binary_tree_traverse_level_order(const binary_tree_t* tree, callback_
     return 0;
 }
 
-int binary_tree_traverse(const binary_tree_t* tree, int order, callback_t on_value)
+static int binary_tree_traverse_with(const binary_tree_t* tree, int order, const binary_tree_callback_t* callback)
 {
-    if (tree == NULL || on_value == NULL) {
-        return -1;
-    }
-
     switch (order) {
     case BINARY_TREE_IN_ORDER:
-        return binary_tree_traverse_in_order(tree, on_value);
+        return binary_tree_traverse_in_order(tree, callback);
     case BINARY_TREE_PRE_ORDER:
-        return binary_tree_traverse_pre_order(tree, on_value);
+        return binary_tree_traverse_pre_order(tree, callback);
     case BINARY_TREE_POST_ORDER:
-        return binary_tree_traverse_post_order(tree, on_value);
+        return binary_tree_traverse_post_order(tree, callback);
     case BINARY_TREE_LEVEL_ORDER:
-        return binary_tree_traverse_level_order(tree, on_value);
+        return binary_tree_traverse_level_order(tree, callback);
     default:
         break;
     }
@@ -305,6 +319,26 @@ int binary_tree_traverse(const binary_tree_t* tree, int order, callback_t on_val
     return -1;
 }
 
+int binary_tree_traverse(const binary_tree_t* tree, int order, callback_t on_value)
+{
+    if (tree == NULL || on_value == NULL) {
+        return -1;
+    }
+
+    binary_tree_callback_t callback = { on_value, NULL, NULL };
+    return binary_tree_traverse_with(tree, order, &callback);
+}
+
+int binary_tree_traverse_ctx(const binary_tree_t* tree, int order, callback_ctx_t on_value, void* ctx)
+{
+    if (tree == NULL || on_value == NULL) {
+        return -1;
+    }
+
+    binary_tree_callback_t callback = { NULL, on_value, ctx };
+    return binary_tree_traverse_with(tree, order, &callback);
+}
+
 int binary_tree_is_empty(const binary_tree_t* tree)
 {
     return binary_tree_size(tree) == 0;
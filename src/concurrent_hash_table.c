@@ -0,0 +1,562 @@
+#if !defined(_WIN32)
+#define _POSIX_C_SOURCE 200809L
+#endif
+
+#include "marlo/concurrent_hash_table.h"
+#include "hash.h"
+
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if !defined(_WIN32)
+#include <sched.h>
+#endif
+
+#define RESIZE_FACTOR 2
+#define MAX_LOAD_FACTOR 0.75
+#define MIN_CAPACITY 8
+#define SHARD_BITS 6
+#define SHARD_COUNT (1 << SHARD_BITS)
+#define CACHE_LINE 64
+#define MAX_SPIN 64
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define CPU_RELAX() __builtin_ia32_pause()
+#elif defined(__GNUC__) && defined(__aarch64__)
+#define CPU_RELAX() __asm__ __volatile__("yield")
+#else
+#define CPU_RELAX() ((void) 0)
+#endif
+
+/**
+ * Slot, empty if `value` is `NULL`.
+ * Lookups read slots while writers update them, hence the atomics, torn
+ * reads are detected through the shard's sequence number and retried.
+ */
+typedef struct concurrent_slot_t {
+    _Atomic uint64_t hash;
+    _Atomic(const void*) key;
+    atomic_size_t key_size;
+    _Atomic(const void*) value;
+} concurrent_slot_t;
+
+typedef struct concurrent_slots_t concurrent_slots_t;
+
+/**
+ * Power of two array of slots, linearly probed from the slot given by the
+ * hash bits right below the shard bits.
+ * Arrays replaced by a resize are chained through `retired` and only freed
+ * by `concurrent_hash_table_reclaim()` or with the table, since lookups may
+ * still be reading them. Each is half the size of the next one, so together
+ * they're never larger than the current array.
+ */
+struct concurrent_slots_t {
+    concurrent_slots_t* retired;
+    size_t capacity;
+    int shift;
+    concurrent_slot_t items[];
+};
+
+/**
+ * Independent part of the table, on its own cache line.
+ * Writers take `lock` and make `sequence` odd while they modify the slots,
+ * lookups don't lock and retry if `sequence` changed under them (seqlock).
+ */
+typedef union concurrent_shard_t {
+    struct {
+        atomic_uint sequence;
+        atomic_flag lock;
+        _Atomic(concurrent_slots_t*) slots;
+        atomic_size_t size;
+    };
+    char padding[CACHE_LINE];
+} concurrent_shard_t;
+
+struct concurrent_hash_table_t {
+    int mode;
+    concurrent_shard_t* shards;
+    void* memory;
+};
+
+static concurrent_slots_t* concurrent_slots_new(size_t capacity)
+{
+    concurrent_slots_t* slots = (concurrent_slots_t*) calloc(1, sizeof(concurrent_slots_t) + capacity * sizeof(concurrent_slot_t));
+    if (slots == NULL) {
+        return NULL;
+    }
+
+    int shift = 64;
+    for (size_t i = capacity; i > 1; i >>= 1) {
+        shift--;
+    }
+
+    slots->retired = NULL;
+    slots->capacity = capacity;
+    slots->shift = shift;
+    return slots;
+}
+
+static size_t concurrent_slots_home(const concurrent_slots_t* slots, uint64_t hash)
+{
+    return (size_t) ((hash << SHARD_BITS) >> slots->shift);
+}
+
+/**
+ * Inserts a key known not to be in `slots`, the caller makes sure there's a
+ * free slot.
+ */
+static void concurrent_slots_place(concurrent_slots_t* slots, const void* key, size_t key_size, uint64_t hash, const void* value)
+{
+    size_t mask = slots->capacity - 1;
+    size_t pos = concurrent_slots_home(slots, hash);
+    while (atomic_load_explicit(&slots->items[pos].value, memory_order_relaxed) != NULL) {
+        pos = (pos + 1) & mask;
+    }
+
+    concurrent_slot_t* slot = &slots->items[pos];
+    atomic_store_explicit(&slot->hash, hash, memory_order_relaxed);
+    atomic_store_explicit(&slot->key, key, memory_order_relaxed);
+    atomic_store_explicit(&slot->key_size, key_size, memory_order_relaxed);
+    atomic_store_explicit(&slot->value, value, memory_order_relaxed);
+}
+
+static void concurrent_slots_release(concurrent_slots_t* slots)
+{
+    while (slots != NULL) {
+        concurrent_slots_t* retired = slots->retired;
+        free(slots);
+        slots = retired;
+    }
+}
+
+concurrent_hash_table_t* concurrent_hash_table_new(int mode, size_t capacity)
+{
+    if (mode != HASH_TABLE_ADDRESS && mode != HASH_TABLE_STRING && mode != HASH_TABLE_BYTES) {
+        return NULL;
+    }
+
+    size_t shard_capacity = hash_round_capacity(capacity / SHARD_COUNT, MIN_CAPACITY);
+    if (shard_capacity == 0 || shard_capacity > SIZE_MAX / RESIZE_FACTOR / sizeof(concurrent_slot_t)) {
+        return NULL;
+    }
+
+    concurrent_hash_table_t* table = (concurrent_hash_table_t*) malloc(sizeof(concurrent_hash_table_t));
+    if (table == NULL) {
+        return NULL;
+    }
+
+    void* memory = malloc(SHARD_COUNT * sizeof(concurrent_shard_t) + CACHE_LINE);
+    if (memory == NULL) {
+        free(table);
+        return NULL;
+    }
+
+    uintptr_t aligned = ((uintptr_t) memory + CACHE_LINE - 1) & ~(uintptr_t) (CACHE_LINE - 1);
+    table->mode = mode;
+    table->shards = (concurrent_shard_t*) aligned;
+    table->memory = memory;
+
+    for (size_t i = 0; i < SHARD_COUNT; i++) {
+        concurrent_shard_t* shard = &table->shards[i];
+        concurrent_slots_t* slots = concurrent_slots_new(shard_capacity);
+        if (slots == NULL) {
+            for (size_t j = 0; j < i; j++) {
+                concurrent_slots_release(atomic_load_explicit(&table->shards[j].slots, memory_order_relaxed));
+            }
+
+            free(memory);
+            free(table);
+            return NULL;
+        }
+
+        atomic_init(&shard->sequence, 0);
+        atomic_flag_clear(&shard->lock);
+        atomic_init(&shard->slots, slots);
+        atomic_init(&shard->size, 0);
+    }
+
+    return table;
+}
+
+int concurrent_hash_table_mode(const concurrent_hash_table_t* table)
+{
+    if (table == NULL) {
+        return -1;
+    }
+
+    return table->mode;
+}
+
+/**
+ * Resolves the given key for the table's mode.
+ * Returns 0 on success or -1 on error (invalid key).
+ */
+static int concurrent_hash_table_key(const concurrent_hash_table_t* table, const void* key, hash_key_t* out)
+{
+    if (hash_key_resolve(table->mode, key, out) == -1) {
+        return -1;
+    }
+
+    out->hash = table->mode == HASH_TABLE_ADDRESS ? hash_address(key) : hash_bytes(out->data, out->size, 0);
+    return 0;
+}
+
+static int concurrent_hash_table_equals(const concurrent_hash_table_t* table, const void* key, const hash_key_t* target)
+{
+    if (table->mode == HASH_TABLE_ADDRESS) {
+        return key == target->data;
+    }
+
+    return target->size == 0 || !memcmp(key, target->data, target->size);
+}
+
+static concurrent_shard_t* concurrent_hash_table_shard(const concurrent_hash_table_t* table, uint64_t hash)
+{
+    return &table->shards[hash >> (64 - SHARD_BITS)];
+}
+
+/**
+ * Waits a little before trying again to get something another thread holds,
+ * twice as long as the previous time, up to `MAX_SPIN` pauses after which
+ * the thread yields its processor instead.
+ */
+static void concurrent_backoff(unsigned* spins)
+{
+    if (*spins < MAX_SPIN) {
+        for (unsigned i = 0; i < *spins; i++) {
+            CPU_RELAX();
+        }
+
+        *spins *= 2;
+    } else {
+#if !defined(_WIN32)
+        sched_yield();
+#else
+        CPU_RELAX();
+#endif
+    }
+}
+
+static void concurrent_shard_lock(concurrent_shard_t* shard)
+{
+    unsigned spins = 1;
+    while (atomic_flag_test_and_set_explicit(&shard->lock, memory_order_acquire)) {
+        concurrent_backoff(&spins);
+    }
+}
+
+static void concurrent_shard_unlock(concurrent_shard_t* shard)
+{
+    atomic_flag_clear_explicit(&shard->lock, memory_order_release);
+}
+
+/**
+ * Opens a write section, the shard lock must be held.
+ */
+static void concurrent_shard_begin_write(concurrent_shard_t* shard)
+{
+    unsigned sequence = atomic_load_explicit(&shard->sequence, memory_order_relaxed);
+    atomic_store_explicit(&shard->sequence, sequence + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+}
+
+static void concurrent_shard_end_write(concurrent_shard_t* shard)
+{
+    unsigned sequence = atomic_load_explicit(&shard->sequence, memory_order_relaxed);
+    atomic_store_explicit(&shard->sequence, sequence + 1, memory_order_release);
+}
+
+/**
+ * Returns the position of the given key within `slots` or `capacity` if not
+ * found, the shard lock must be held.
+ */
+static size_t concurrent_shard_find(const concurrent_hash_table_t* table, const concurrent_slots_t* slots, const hash_key_t* key)
+{
+    size_t mask = slots->capacity - 1;
+    size_t pos = concurrent_slots_home(slots, key->hash);
+    for (size_t i = 0; i < slots->capacity; i++) {
+        const concurrent_slot_t* slot = &slots->items[pos];
+        if (atomic_load_explicit(&slot->value, memory_order_relaxed) == NULL) {
+            break;
+        }
+
+        if (atomic_load_explicit(&slot->hash, memory_order_relaxed) == key->hash
+            && atomic_load_explicit(&slot->key_size, memory_order_relaxed) == key->size
+            && concurrent_hash_table_equals(table, atomic_load_explicit(&slot->key, memory_order_relaxed), key)) {
+            return pos;
+        }
+
+        pos = (pos + 1) & mask;
+    }
+
+    return slots->capacity;
+}
+
+/**
+ * Moves every slot into an array twice as large and publishes it.
+ * The old array isn't modified anymore, so lookups still reading it see a
+ * consistent (if stale) table and no write section is needed.
+ */
+static int concurrent_shard_resize(concurrent_shard_t* shard, concurrent_slots_t* slots)
+{
+    if (slots->capacity > SIZE_MAX / RESIZE_FACTOR / sizeof(concurrent_slot_t)) {
+        return -1;
+    }
+
+    concurrent_slots_t* new_slots = concurrent_slots_new(slots->capacity * RESIZE_FACTOR);
+    if (new_slots == NULL) {
+        return -1;
+    }
+
+    for (size_t i = 0; i < slots->capacity; i++) {
+        const concurrent_slot_t* slot = &slots->items[i];
+        const void* value = atomic_load_explicit(&slot->value, memory_order_relaxed);
+        if (value != NULL) {
+            concurrent_slots_place(new_slots,
+                atomic_load_explicit(&slot->key, memory_order_relaxed),
+                atomic_load_explicit(&slot->key_size, memory_order_relaxed),
+                atomic_load_explicit(&slot->hash, memory_order_relaxed),
+                value);
+        }
+    }
+
+    new_slots->retired = slots;
+    atomic_store_explicit(&shard->slots, new_slots, memory_order_release);
+    return 0;
+}
+
+int concurrent_hash_table_push(concurrent_hash_table_t* table, const void* key, const void* value)
+{
+    hash_key_t resolved;
+    if (table == NULL || value == NULL || concurrent_hash_table_key(table, key, &resolved) == -1) {
+        return -1;
+    }
+
+    concurrent_shard_t* shard = concurrent_hash_table_shard(table, resolved.hash);
+    concurrent_shard_lock(shard);
+
+    concurrent_slots_t* slots = atomic_load_explicit(&shard->slots, memory_order_relaxed);
+    size_t pos = concurrent_shard_find(table, slots, &resolved);
+    if (pos < slots->capacity) {
+        concurrent_shard_begin_write(shard);
+        atomic_store_explicit(&slots->items[pos].value, value, memory_order_relaxed);
+        concurrent_shard_end_write(shard);
+        concurrent_shard_unlock(shard);
+        return 0;
+    }
+
+    size_t size = atomic_load_explicit(&shard->size, memory_order_relaxed);
+    if (!((float) (size + 1) / (float) slots->capacity < MAX_LOAD_FACTOR)) {
+        int error = concurrent_shard_resize(shard, slots);
+        if (error == -1) {
+            concurrent_shard_unlock(shard);
+            return -1;
+        }
+
+        slots = atomic_load_explicit(&shard->slots, memory_order_relaxed);
+    }
+
+    concurrent_shard_begin_write(shard);
+    concurrent_slots_place(slots, resolved.data, resolved.size, resolved.hash, value);
+    atomic_store_explicit(&shard->size, size + 1, memory_order_relaxed);
+    concurrent_shard_end_write(shard);
+    concurrent_shard_unlock(shard);
+    return 0;
+}
+
+/**
+ * Lookup under the shard lock, used when the lock free path finds a key with
+ * the same hash but different contents.
+ */
+static const void* concurrent_shard_at_locked(const concurrent_hash_table_t* table, concurrent_shard_t* shard, const hash_key_t* key)
+{
+    concurrent_shard_lock(shard);
+    const concurrent_slots_t* slots = atomic_load_explicit(&shard->slots, memory_order_relaxed);
+    size_t pos = concurrent_shard_find(table, slots, key);
+    const void* value = pos < slots->capacity ? atomic_load_explicit(&slots->items[pos].value, memory_order_relaxed) : NULL;
+    concurrent_shard_unlock(shard);
+    return value;
+}
+
+/**
+ * Lock free lookup.
+ * The probe only looks at hashes and sizes, the candidate key is compared
+ * once the snapshot has been validated, so no torn key/size pair is ever
+ * dereferenced.
+ */
+const void* concurrent_hash_table_at(const concurrent_hash_table_t* table, const void* key)
+{
+    hash_key_t resolved;
+    if (table == NULL || concurrent_hash_table_key(table, key, &resolved) == -1) {
+        return NULL;
+    }
+
+    concurrent_shard_t* shard = concurrent_hash_table_shard(table, resolved.hash);
+    unsigned spins = 1;
+    for (;;) {
+        unsigned sequence = atomic_load_explicit(&shard->sequence, memory_order_acquire);
+        if (sequence & 1) {
+            concurrent_backoff(&spins);
+            continue;
+        }
+
+        const concurrent_slots_t* slots = atomic_load_explicit(&shard->slots, memory_order_acquire);
+        size_t mask = slots->capacity - 1;
+        size_t pos = concurrent_slots_home(slots, resolved.hash);
+        const void* candidate = NULL;
+        const void* value = NULL;
+        for (size_t i = 0; i < slots->capacity; i++) {
+            const concurrent_slot_t* slot = &slots->items[pos];
+            const void* slot_value = atomic_load_explicit(&slot->value, memory_order_relaxed);
+            if (slot_value == NULL) {
+                break;
+            }
+
+            if (atomic_load_explicit(&slot->hash, memory_order_relaxed) == resolved.hash
+                && atomic_load_explicit(&slot->key_size, memory_order_relaxed) == resolved.size) {
+                candidate = atomic_load_explicit(&slot->key, memory_order_relaxed);
+                value = slot_value;
+                break;
+            }
+
+            pos = (pos + 1) & mask;
+        }
+
+        atomic_thread_fence(memory_order_acquire);
+        if (atomic_load_explicit(&shard->sequence, memory_order_relaxed) != sequence) {
+            concurrent_backoff(&spins);
+            continue;
+        }
+
+        if (value == NULL || concurrent_hash_table_equals(table, candidate, &resolved)) {
+            return value;
+        }
+
+        return concurrent_shard_at_locked(table, shard, &resolved);
+    }
+}
+
+int concurrent_hash_table_contains(const concurrent_hash_table_t* table, const void* key)
+{
+    return concurrent_hash_table_at(table, key) != NULL;
+}
+
+/**
+ * Empties the slot at the given position, moving back the following slots
+ * that would become unreachable (linear probing backward shift deletion).
+ */
+static void concurrent_slots_erase(concurrent_slots_t* slots, size_t pos)
+{
+    size_t mask = slots->capacity - 1;
+    size_t next = pos;
+    for (;;) {
+        next = (next + 1) & mask;
+        concurrent_slot_t* slot = &slots->items[next];
+        const void* value = atomic_load_explicit(&slot->value, memory_order_relaxed);
+        if (value == NULL) {
+            break;
+        }
+
+        uint64_t hash = atomic_load_explicit(&slot->hash, memory_order_relaxed);
+        size_t home = concurrent_slots_home(slots, hash);
+        if (((next - home) & mask) < ((next - pos) & mask)) {
+            continue;
+        }
+
+        concurrent_slot_t* hole = &slots->items[pos];
+        atomic_store_explicit(&hole->hash, hash, memory_order_relaxed);
+        atomic_store_explicit(&hole->key, atomic_load_explicit(&slot->key, memory_order_relaxed), memory_order_relaxed);
+        atomic_store_explicit(&hole->key_size, atomic_load_explicit(&slot->key_size, memory_order_relaxed), memory_order_relaxed);
+        atomic_store_explicit(&hole->value, value, memory_order_relaxed);
+        pos = next;
+    }
+
+    concurrent_slot_t* hole = &slots->items[pos];
+    atomic_store_explicit(&hole->value, NULL, memory_order_relaxed);
+    atomic_store_explicit(&hole->key, NULL, memory_order_relaxed);
+    atomic_store_explicit(&hole->key_size, 0, memory_order_relaxed);
+    atomic_store_explicit(&hole->hash, 0, memory_order_relaxed);
+}
+
+void concurrent_hash_table_remove(concurrent_hash_table_t* table, const void* key)
+{
+    hash_key_t resolved;
+    if (table == NULL || concurrent_hash_table_key(table, key, &resolved) == -1) {
+        return;
+    }
+
+    concurrent_shard_t* shard = concurrent_hash_table_shard(table, resolved.hash);
+    concurrent_shard_lock(shard);
+
+    concurrent_slots_t* slots = atomic_load_explicit(&shard->slots, memory_order_relaxed);
+    size_t pos = concurrent_shard_find(table, slots, &resolved);
+    if (pos < slots->capacity) {
+        concurrent_shard_begin_write(shard);
+        concurrent_slots_erase(slots, pos);
+        atomic_store_explicit(&shard->size, atomic_load_explicit(&shard->size, memory_order_relaxed) - 1, memory_order_relaxed);
+        concurrent_shard_end_write(shard);
+    }
+
+    concurrent_shard_unlock(shard);
+}
+
+void concurrent_hash_table_clear(concurrent_hash_table_t* table)
+{
+    if (table != NULL) {
+        for (size_t i = 0; i < SHARD_COUNT; i++) {
+            concurrent_shard_t* shard = &table->shards[i];
+            concurrent_shard_lock(shard);
+            concurrent_shard_begin_write(shard);
+
+            concurrent_slots_t* slots = atomic_load_explicit(&shard->slots, memory_order_relaxed);
+            for (size_t j = 0; j < slots->capacity; j++) {
+                atomic_store_explicit(&slots->items[j].value, NULL, memory_order_relaxed);
+            }
+
+            atomic_store_explicit(&shard->size, 0, memory_order_relaxed);
+            concurrent_shard_end_write(shard);
+            concurrent_shard_unlock(shard);
+        }
+    }
+}
+
+size_t concurrent_hash_table_size(const concurrent_hash_table_t* table)
+{
+    size_t size = 0;
+    if (table != NULL) {
+        for (size_t i = 0; i < SHARD_COUNT; i++) {
+            size += atomic_load_explicit(&table->shards[i].size, memory_order_relaxed);
+        }
+    }
+
+    return size;
+}
+
+void concurrent_hash_table_reclaim(concurrent_hash_table_t* table)
+{
+    if (table != NULL) {
+        for (size_t i = 0; i < SHARD_COUNT; i++) {
+            concurrent_shard_t* shard = &table->shards[i];
+            concurrent_shard_lock(shard);
+            concurrent_slots_t* slots = atomic_load_explicit(&shard->slots, memory_order_relaxed);
+            concurrent_slots_t* retired = slots->retired;
+            slots->retired = NULL;
+            concurrent_shard_unlock(shard);
+            concurrent_slots_release(retired);
+        }
+    }
+}
+
+void concurrent_hash_table_release(concurrent_hash_table_t* table)
+{
+    if (table != NULL) {
+        for (size_t i = 0; i < SHARD_COUNT; i++) {
+            concurrent_slots_release(atomic_load_explicit(&table->shards[i].slots, memory_order_relaxed));
+        }
+
+        free(table->memory);
+        free(table);
+    }
+}
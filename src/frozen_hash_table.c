@@ -0,0 +1,837 @@
+#if !defined(_WIN32)
+#define _POSIX_C_SOURCE 200809L
+#endif
+
+#include "marlo/frozen_hash_table.h"
+#include "hash.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#define BUCKET_SIZE 4
+#define MAX_PILOT (1u << 20)
+#define MAX_SEEDS 16
+#define SPARE_RATIO 32
+#define FILE_MAGIC 0x5448464d
+#define FILE_VERSION 3
+#define FILE_BYTE_ORDER 0x01020304
+#define FILE_ALIGNMENT 8
+
+/**
+ * PTHash-like minimal perfect hash.
+ * Keys are split into buckets by the top bits of their hash, every bucket has
+ * a pilot picked at build time so the keys it holds land on free positions
+ * once mixed with it. Lookups hash the key, read the pilot of its bucket and
+ * land on the only position the key can be at.
+ * There are `positions` positions, about 3% more than keys, so even the last
+ * buckets placed find free positions within a few dozen pilots. Keys landing
+ * past `size` are sent by `remap` to the positions no key landed on, so
+ * `items` has no holes.
+ * String and bytes keys are copied into `keys`.
+ * Mapped tables have no `items` nor `keys`, `pilots`, `remap` and `slots`
+ * point into the `file_size` bytes of the file at `file` instead.
+ */
+struct frozen_hash_table_t {
+    int mode;
+    int shift;
+    uint64_t seed;
+    size_t size;
+    size_t positions;
+    const uint32_t* pilots;
+    const uint64_t* remap;
+    hash_table_item_t* items;
+    char* keys;
+    const struct frozen_slot_t* slots;
+    const unsigned char* file;
+    size_t file_size;
+};
+
+/**
+ * File header, followed by the pilots, the remapped positions, the slots and
+ * finally the keys and values they refer to.
+ * Every offset is relative to the start of the file and aligned to
+ * `FILE_ALIGNMENT` bytes, integers are stored in native byte order.
+ */
+typedef struct frozen_header_t {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t byte_order;
+    int32_t mode;
+    uint64_t shift;
+    uint64_t seed;
+    uint64_t size;
+    uint64_t positions;
+    uint64_t count;
+    uint64_t pilots;
+    uint64_t remap;
+    uint64_t slots;
+    uint64_t file_size;
+} frozen_header_t;
+
+/**
+ * Item as stored in a file.
+ * `key` is the address itself in address mode, an offset otherwise.
+ * Keys and values are both followed by a null byte, so neither can be read
+ * past the end of the file as a string.
+ */
+typedef struct frozen_slot_t {
+    uint64_t key;
+    uint64_t key_size;
+    uint64_t value;
+    uint64_t value_size;
+} frozen_slot_t;
+
+/**
+ * Scratch space for building the table.
+ * `order` holds item indices grouped by bucket, bucket `i` spanning from
+ * `starts[i]` to `starts[i + 1]`, and `buckets` holds bucket indices sorted
+ * by size, largest first, so the hardest ones are placed while most
+ * positions are still free.
+ */
+typedef struct frozen_build_t {
+    uint64_t* hashes;
+    size_t* order;
+    size_t* starts;
+    size_t* buckets;
+    size_t* positions;
+    unsigned char* taken;
+    uint32_t* pilots;
+    size_t count;
+} frozen_build_t;
+
+/**
+ * Addresses are mixed further than in `hash_table.c`, since the hashes are
+ * mixed again with the pilots and every bit ends up mattering.
+ */
+static uint64_t frozen_hash(int mode, const void* data, size_t size, uint64_t seed)
+{
+    if (mode == HASH_TABLE_ADDRESS) {
+        return hash_mix(hash_address(data) ^ seed);
+    }
+
+    return hash_bytes(data, size, seed);
+}
+
+static size_t frozen_hash_table_bucket(const frozen_hash_table_t* table, uint64_t hash)
+{
+    return (size_t) (hash >> table->shift);
+}
+
+static size_t frozen_hash_table_position(const frozen_hash_table_t* table, uint64_t hash, uint32_t pilot)
+{
+    return (size_t) hash_range(hash_mix(hash ^ ((uint64_t) pilot * FIBONACCI)), table->positions);
+}
+
+/**
+ * Returns the index of the item the given hash leads to, which is only out
+ * of bounds in corrupt files.
+ */
+static size_t frozen_hash_table_index(const frozen_hash_table_t* table, uint64_t hash)
+{
+    size_t pos = frozen_hash_table_position(table, hash, table->pilots[frozen_hash_table_bucket(table, hash)]);
+    return pos < table->size ? pos : (size_t) table->remap[pos - table->size];
+}
+
+static void frozen_build_release(frozen_build_t* build)
+{
+    free(build->hashes);
+    free(build->order);
+    free(build->starts);
+    free(build->buckets);
+    free(build->positions);
+    free(build->taken);
+}
+
+static int frozen_build_init(frozen_build_t* build, size_t size, size_t positions, size_t count)
+{
+    build->hashes = (uint64_t*) malloc(size * sizeof(uint64_t));
+    build->order = (size_t*) malloc(size * sizeof(size_t));
+    build->starts = (size_t*) malloc((count + 1) * sizeof(size_t));
+    build->buckets = (size_t*) malloc(count * sizeof(size_t));
+    build->positions = (size_t*) malloc(((size > count ? size : count) + 1) * sizeof(size_t));
+    build->taken = (unsigned char*) malloc(positions);
+    build->count = count;
+    if (build->hashes == NULL || build->order == NULL || build->starts == NULL || build->buckets == NULL
+        || build->positions == NULL || build->taken == NULL) {
+        frozen_build_release(build);
+        return -1;
+    }
+
+    return 0;
+}
+
+/**
+ * Hashes every key with the table's seed and groups them by bucket, then
+ * sorts the buckets by size.
+ */
+static void frozen_build_group(frozen_build_t* build, const frozen_hash_table_t* table)
+{
+    size_t* starts = build->starts;
+    memset(starts, 0, (build->count + 1) * sizeof(size_t));
+    for (size_t i = 0; i < table->size; i++) {
+        const hash_table_item_t* item = &table->items[i];
+        build->hashes[i] = frozen_hash(table->mode, item->key, item->key_size, table->seed);
+        starts[frozen_hash_table_bucket(table, build->hashes[i])]++;
+    }
+
+    size_t max_size = 0;
+    for (size_t i = 0; i < build->count; i++) {
+        max_size = starts[i] > max_size ? starts[i] : max_size;
+        starts[i + 1] += starts[i];
+    }
+
+    for (size_t i = 0; i < table->size; i++) {
+        build->order[--starts[frozen_hash_table_bucket(table, build->hashes[i])]] = i;
+    }
+
+    size_t* sizes = build->positions;
+    memset(sizes, 0, (max_size + 1) * sizeof(size_t));
+    for (size_t i = 0; i < build->count; i++) {
+        sizes[starts[i + 1] - starts[i]]++;
+    }
+
+    size_t offset = 0;
+    for (size_t i = max_size + 1; i-- > 0;) {
+        size_t count = sizes[i];
+        sizes[i] = offset;
+        offset += count;
+    }
+
+    for (size_t i = 0; i < build->count; i++) {
+        build->buckets[sizes[starts[i + 1] - starts[i]]++] = i;
+    }
+}
+
+/**
+ * Looks for a pilot that sends every key of the given bucket to a free
+ * position, and takes those positions.
+ * Returns 0 on success or -1 on error (no pilot found).
+ */
+static int frozen_build_place(frozen_build_t* build, frozen_hash_table_t* table, size_t bucket)
+{
+    const size_t* keys = &build->order[build->starts[bucket]];
+    size_t size = build->starts[bucket + 1] - build->starts[bucket];
+    for (size_t i = 0; i < size; i++) {
+        for (size_t j = i + 1; j < size; j++) {
+            if (build->hashes[keys[i]] == build->hashes[keys[j]]) {
+                return -1;
+            }
+        }
+    }
+
+    for (uint32_t pilot = 0; pilot < MAX_PILOT; pilot++) {
+        size_t placed = 0;
+        while (placed < size) {
+            size_t pos = frozen_hash_table_position(table, build->hashes[keys[placed]], pilot);
+            if (build->taken[pos]) {
+                break;
+            }
+
+            build->taken[pos] = 1;
+            build->positions[placed++] = pos;
+        }
+
+        if (placed == size) {
+            build->pilots[bucket] = pilot;
+            return 0;
+        }
+
+        while (placed > 0) {
+            build->taken[build->positions[--placed]] = 0;
+        }
+    }
+
+    return -1;
+}
+
+/**
+ * Sends the taken positions past the table's size to the free ones before
+ * it, in order.
+ */
+static void frozen_build_remap(const frozen_build_t* build, frozen_hash_table_t* table, uint64_t* remap)
+{
+    size_t free_pos = 0;
+    for (size_t pos = table->size; pos < table->positions; pos++) {
+        remap[pos - table->size] = 0;
+        if (build->taken[pos]) {
+            while (build->taken[free_pos]) {
+                free_pos++;
+            }
+
+            remap[pos - table->size] = free_pos++;
+        }
+    }
+}
+
+/**
+ * Picks the pilots and moves every item to its final position.
+ * The search starts over with a different seed if some bucket can't be
+ * placed.
+ * Returns 0 on success or -1 on error.
+ */
+static int frozen_hash_table_build(frozen_hash_table_t* table)
+{
+    size_t count = 2;
+    while (count < table->size / BUCKET_SIZE + 1) {
+        count *= 2;
+    }
+
+    int shift = 64;
+    for (size_t i = count; i > 1; i >>= 1) {
+        shift--;
+    }
+
+    uint32_t* pilots = (uint32_t*) calloc(count, sizeof(uint32_t));
+    if (pilots == NULL) {
+        return -1;
+    }
+
+    table->shift = shift;
+    table->pilots = pilots;
+
+    if (table->size == 0) {
+        return 0;
+    }
+
+    table->positions = table->size + table->size / SPARE_RATIO + 1;
+    uint64_t* remap = (uint64_t*) malloc((table->positions - table->size) * sizeof(uint64_t));
+    if (remap == NULL) {
+        return -1;
+    }
+
+    table->remap = remap;
+
+    frozen_build_t build;
+    hash_table_item_t* items = (hash_table_item_t*) malloc(table->size * sizeof(hash_table_item_t));
+    if (items == NULL || frozen_build_init(&build, table->size, table->positions, count) == -1) {
+        free(items);
+        return -1;
+    }
+
+    build.pilots = pilots;
+    int error = -1;
+    for (uint64_t seed = 0; seed < MAX_SEEDS && error == -1; seed++) {
+        table->seed = hash_mix(seed + 1);
+        frozen_build_group(&build, table);
+        memset(build.taken, 0, table->positions);
+        memset(pilots, 0, count * sizeof(uint32_t));
+        error = 0;
+        for (size_t i = 0; i < count && error == 0; i++) {
+            error = frozen_build_place(&build, table, build.buckets[i]);
+        }
+    }
+
+    if (error == 0) {
+        frozen_build_remap(&build, table, remap);
+        for (size_t i = 0; i < table->size; i++) {
+            items[frozen_hash_table_index(table, build.hashes[i])] = table->items[i];
+        }
+
+        free(table->items);
+        table->items = items;
+    } else {
+        free(items);
+    }
+
+    frozen_build_release(&build);
+    return error;
+}
+
+/**
+ * Copies the key-value pairs of the given table, along with their keys in
+ * string and bytes modes.
+ * Returns 0 on success or -1 on error.
+ */
+static int frozen_hash_table_copy(frozen_hash_table_t* table, const hash_table_t* source)
+{
+    if (table->size == 0) {
+        return 0;
+    }
+
+    table->items = (hash_table_item_t*) malloc(table->size * sizeof(hash_table_item_t));
+    if (table->items == NULL) {
+        return -1;
+    }
+
+    size_t key_bytes = 0;
+    hash_table_iterator_t iter;
+    if (table->mode != HASH_TABLE_ADDRESS) {
+        for (iter = hash_table_begin(source); hash_table_is_valid(iter); iter = hash_table_next(iter)) {
+            key_bytes += hash_table_item(iter).key_size + 1;
+        }
+
+        table->keys = (char*) malloc(key_bytes);
+        if (table->keys == NULL) {
+            return -1;
+        }
+    }
+
+    size_t i = 0;
+    char* key = table->keys;
+    for (iter = hash_table_begin(source); hash_table_is_valid(iter); iter = hash_table_next(iter)) {
+        hash_table_item_t item = hash_table_item(iter);
+        if (key != NULL) {
+            if (item.key_size > 0) {
+                memcpy(key, item.key, item.key_size);
+            }
+
+            key[item.key_size] = '\0';
+            item.key = key;
+            key += item.key_size + 1;
+        }
+
+        table->items[i++] = item;
+    }
+
+    return 0;
+}
+
+frozen_hash_table_t* hash_table_freeze(const hash_table_t* source)
+{
+    int mode = hash_table_mode(source);
+    if (mode != HASH_TABLE_ADDRESS && mode != HASH_TABLE_STRING && mode != HASH_TABLE_BYTES) {
+        return NULL;
+    }
+
+    frozen_hash_table_t* table = (frozen_hash_table_t*) malloc(sizeof(frozen_hash_table_t));
+    if (table == NULL) {
+        return NULL;
+    }
+
+    table->mode = mode;
+    table->shift = 64;
+    table->seed = 0;
+    table->size = hash_table_size(source);
+    table->positions = 0;
+    table->pilots = NULL;
+    table->remap = NULL;
+    table->items = NULL;
+    table->keys = NULL;
+    table->slots = NULL;
+    table->file = NULL;
+    table->file_size = 0;
+
+    if (frozen_hash_table_copy(table, source) == -1 || frozen_hash_table_build(table) == -1) {
+        frozen_hash_table_release(table);
+        return NULL;
+    }
+
+    return table;
+}
+
+/**
+ * Returns the item at the given index, read from the file for mapped tables.
+ * Items whose keys or values don't fit in the file, or aren't followed by
+ * their null byte, come back `NULL`ed/zero.
+ */
+static hash_table_item_t frozen_hash_table_slot(const frozen_hash_table_t* table, size_t index)
+{
+    if (table->slots == NULL) {
+        return table->items[index];
+    }
+
+    hash_table_item_t item;
+    item.key = NULL;
+    item.value = NULL;
+    item.key_size = 0;
+
+    const frozen_slot_t* slot = &table->slots[index];
+    if (slot->value_size >= table->file_size || slot->value >= table->file_size - slot->value_size
+        || table->file[slot->value + slot->value_size] != '\0') {
+        return item;
+    }
+
+    if (table->mode == HASH_TABLE_ADDRESS) {
+        item.key = (const void*) (uintptr_t) slot->key;
+    } else if (slot->key_size < table->file_size && slot->key < table->file_size - slot->key_size
+        && table->file[slot->key + slot->key_size] == '\0') {
+        item.key = &table->file[slot->key];
+        item.key_size = (size_t) slot->key_size;
+    } else {
+        return item;
+    }
+
+    item.value = &table->file[slot->value];
+    return item;
+}
+
+static int frozen_file_write(FILE* file, const void* data, size_t size, uint64_t* offset)
+{
+    if (size > 0 && fwrite(data, 1, size, file) != size) {
+        return -1;
+    }
+
+    *offset += size;
+    return 0;
+}
+
+/**
+ * Writes zeros up to the next multiple of `FILE_ALIGNMENT`.
+ */
+static int frozen_file_pad(FILE* file, uint64_t* offset)
+{
+    static const unsigned char zeros[FILE_ALIGNMENT] = {0};
+    size_t padding = (size_t) ((FILE_ALIGNMENT - *offset % FILE_ALIGNMENT) % FILE_ALIGNMENT);
+    return frozen_file_write(file, zeros, padding, offset);
+}
+
+static uint64_t frozen_file_align(uint64_t offset)
+{
+    return (offset + FILE_ALIGNMENT - 1) / FILE_ALIGNMENT * FILE_ALIGNMENT;
+}
+
+/**
+ * Lays out the keys and values of the table after the slots, filling in
+ * `slots`, `sizes` (the size of every value) and the file size.
+ */
+static void frozen_file_layout(const frozen_hash_table_t* table, frozen_header_t* header, frozen_slot_t* slots, size_t* sizes, frozen_hash_table_value_size_t value_size, void* ctx)
+{
+    uint64_t offset = header->slots + header->size * sizeof(frozen_slot_t);
+    for (size_t i = 0; i < table->size; i++) {
+        hash_table_item_t item = frozen_hash_table_slot(table, i);
+        if (table->mode == HASH_TABLE_ADDRESS) {
+            slots[i].key = (uint64_t) (uintptr_t) item.key;
+            slots[i].key_size = 0;
+        } else {
+            slots[i].key = offset;
+            slots[i].key_size = item.key_size;
+            offset += item.key_size + 1;
+        }
+
+        offset = frozen_file_align(offset);
+        sizes[i] = value_size != NULL ? value_size(item.value, ctx) : strlen((const char*) item.value) + 1;
+        slots[i].value = offset;
+        slots[i].value_size = sizes[i];
+        offset += sizes[i] + 1;
+    }
+
+    header->file_size = offset;
+}
+
+/**
+ * Writes the table to an open file, see `frozen_header_t` for the format.
+ * Returns 0 on success or -1 on error.
+ */
+static int frozen_file_dump(const frozen_hash_table_t* table, FILE* file, const frozen_header_t* header, const frozen_slot_t* slots, const size_t* sizes)
+{
+    uint64_t offset = 0;
+    if (frozen_file_write(file, header, sizeof(frozen_header_t), &offset) == -1 || frozen_file_pad(file, &offset) == -1
+        || frozen_file_write(file, table->pilots, (size_t) header->count * sizeof(uint32_t), &offset) == -1
+        || frozen_file_pad(file, &offset) == -1
+        || frozen_file_write(file, table->remap, (size_t) (header->positions - header->size) * sizeof(uint64_t), &offset) == -1
+        || frozen_file_pad(file, &offset) == -1
+        || frozen_file_write(file, slots, table->size * sizeof(frozen_slot_t), &offset) == -1) {
+        return -1;
+    }
+
+    for (size_t i = 0; i < table->size; i++) {
+        hash_table_item_t item = frozen_hash_table_slot(table, i);
+        if (table->mode != HASH_TABLE_ADDRESS) {
+            if (frozen_file_write(file, item.key, item.key_size, &offset) == -1 || frozen_file_write(file, "", 1, &offset) == -1) {
+                return -1;
+            }
+        }
+
+        if (frozen_file_pad(file, &offset) == -1 || frozen_file_write(file, item.value, sizes[i], &offset) == -1
+            || frozen_file_write(file, "", 1, &offset) == -1) {
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+int frozen_hash_table_write(const frozen_hash_table_t* table, const char* path, frozen_hash_table_value_size_t value_size, void* ctx)
+{
+    if (table == NULL || path == NULL) {
+        return -1;
+    }
+
+    frozen_header_t header;
+    header.magic = FILE_MAGIC;
+    header.version = FILE_VERSION;
+    header.byte_order = FILE_BYTE_ORDER;
+    header.mode = table->mode;
+    header.shift = (uint64_t) table->shift;
+    header.seed = table->seed;
+    header.size = table->size;
+    header.positions = table->positions;
+    header.count = UINT64_C(1) << (64 - table->shift);
+    header.pilots = frozen_file_align(sizeof(frozen_header_t));
+    header.remap = frozen_file_align(header.pilots + header.count * sizeof(uint32_t));
+    header.slots = frozen_file_align(header.remap + (header.positions - header.size) * sizeof(uint64_t));
+    header.file_size = 0;
+
+    frozen_slot_t* slots = (frozen_slot_t*) malloc((table->size + 1) * sizeof(frozen_slot_t));
+    size_t* sizes = (size_t*) malloc((table->size + 1) * sizeof(size_t));
+    FILE* file = NULL;
+    int error = -1;
+    if (slots != NULL && sizes != NULL) {
+        frozen_file_layout(table, &header, slots, sizes, value_size, ctx);
+        file = fopen(path, "wb");
+    }
+
+    if (file != NULL) {
+        error = frozen_file_dump(table, file, &header, slots, sizes);
+        if (fclose(file) != 0) {
+            error = -1;
+        }
+
+        if (error == -1) {
+            remove(path);
+        }
+    }
+
+    free(slots);
+    free(sizes);
+    return error;
+}
+
+int hash_table_write(const hash_table_t* table, const char* path, frozen_hash_table_value_size_t value_size, void* ctx)
+{
+    frozen_hash_table_t* frozen = hash_table_freeze(table);
+    if (frozen == NULL) {
+        return -1;
+    }
+
+    int error = frozen_hash_table_write(frozen, path, value_size, ctx);
+    frozen_hash_table_release(frozen);
+    return error;
+}
+
+/**
+ * Maps the given file into memory, read-only.
+ * Systems without `mmap()` read it into an allocated buffer instead.
+ * Returns the file contents on success or `NULL` on error.
+ */
+static const unsigned char* frozen_file_load(const char* path, size_t* size)
+{
+#if defined(_WIN32)
+    FILE* file = fopen(path, "rb");
+    if (file == NULL) {
+        return NULL;
+    }
+
+    unsigned char* data = NULL;
+    long length = fseek(file, 0, SEEK_END) == 0 ? ftell(file) : -1;
+    if (length > 0 && fseek(file, 0, SEEK_SET) == 0) {
+        data = (unsigned char*) malloc((size_t) length);
+        if (data != NULL && fread(data, 1, (size_t) length, file) != (size_t) length) {
+            free(data);
+            data = NULL;
+        }
+    }
+
+    fclose(file);
+    *size = (size_t) length;
+    return data;
+#else
+    int fd = open(path, O_RDONLY);
+    if (fd == -1) {
+        return NULL;
+    }
+
+    struct stat info;
+    void* data = MAP_FAILED;
+    if (fstat(fd, &info) == 0 && info.st_size > 0) {
+        data = mmap(NULL, (size_t) info.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    }
+
+    close(fd);
+    if (data == MAP_FAILED) {
+        return NULL;
+    }
+
+    *size = (size_t) info.st_size;
+    return (const unsigned char*) data;
+#endif
+}
+
+static void frozen_file_unload(const unsigned char* data, size_t size)
+{
+#if defined(_WIN32)
+    (void) size;
+    free((void*) data);
+#else
+    munmap((void*) data, size);
+#endif
+}
+
+/**
+ * Checks the header of the mapped file and points the table into it.
+ * Returns 0 on success or -1 on error (not a valid file).
+ */
+static int frozen_hash_table_load(frozen_hash_table_t* table)
+{
+    frozen_header_t header;
+    if (table->file_size < sizeof(frozen_header_t)) {
+        return -1;
+    }
+
+    memcpy(&header, table->file, sizeof(frozen_header_t));
+    if (header.magic != FILE_MAGIC || header.version != FILE_VERSION || header.byte_order != FILE_BYTE_ORDER
+        || header.file_size != table->file_size) {
+        return -1;
+    }
+
+    if (header.mode != HASH_TABLE_ADDRESS && header.mode != HASH_TABLE_STRING && header.mode != HASH_TABLE_BYTES) {
+        return -1;
+    }
+
+    if (header.shift < 1 || header.shift > 63 || header.count != UINT64_C(1) << (64 - header.shift)) {
+        return -1;
+    }
+
+    uint64_t file_size = header.file_size;
+    if (header.pilots % FILE_ALIGNMENT != 0 || header.pilots > file_size || header.count > (file_size - header.pilots) / sizeof(uint32_t)) {
+        return -1;
+    }
+
+    if (header.positions < header.size || (header.size > 0 && header.positions == header.size)) {
+        return -1;
+    }
+
+    if (header.remap % FILE_ALIGNMENT != 0 || header.remap > file_size
+        || header.positions - header.size > (file_size - header.remap) / sizeof(uint64_t)) {
+        return -1;
+    }
+
+    if (header.slots % FILE_ALIGNMENT != 0 || header.slots > file_size || header.size > (file_size - header.slots) / sizeof(frozen_slot_t)) {
+        return -1;
+    }
+
+    table->mode = header.mode;
+    table->shift = (int) header.shift;
+    table->seed = header.seed;
+    table->size = (size_t) header.size;
+    table->positions = (size_t) header.positions;
+    table->pilots = (const uint32_t*) &table->file[header.pilots];
+    table->remap = (const uint64_t*) &table->file[header.remap];
+    table->slots = (const frozen_slot_t*) &table->file[header.slots];
+    return 0;
+}
+
+frozen_hash_table_t* frozen_hash_table_map(const char* path)
+{
+    if (path == NULL) {
+        return NULL;
+    }
+
+    frozen_hash_table_t* table = (frozen_hash_table_t*) malloc(sizeof(frozen_hash_table_t));
+    if (table == NULL) {
+        return NULL;
+    }
+
+    table->mode = 0;
+    table->shift = 64;
+    table->seed = 0;
+    table->size = 0;
+    table->positions = 0;
+    table->pilots = NULL;
+    table->remap = NULL;
+    table->items = NULL;
+    table->keys = NULL;
+    table->slots = NULL;
+    table->file_size = 0;
+    table->file = frozen_file_load(path, &table->file_size);
+
+    if (table->file == NULL || frozen_hash_table_load(table) == -1) {
+        frozen_hash_table_release(table);
+        return NULL;
+    }
+
+    return table;
+}
+
+int frozen_hash_table_mode(const frozen_hash_table_t* table)
+{
+    if (table == NULL) {
+        return -1;
+    }
+
+    return table->mode;
+}
+
+/**
+ * Resolves the given key for the table's mode.
+ * Returns 0 on success or -1 on error (invalid key).
+ */
+static int frozen_hash_table_key(const frozen_hash_table_t* table, const void* key, hash_key_t* out)
+{
+    if (hash_key_resolve(table->mode, key, out) == -1) {
+        return -1;
+    }
+
+    out->hash = frozen_hash(table->mode, out->data, out->size, table->seed);
+    return 0;
+}
+
+const void* frozen_hash_table_at(const frozen_hash_table_t* table, const void* key)
+{
+    hash_key_t resolved;
+    if (frozen_hash_table_size(table) == 0 || frozen_hash_table_key(table, key, &resolved) == -1) {
+        return NULL;
+    }
+
+    size_t index = frozen_hash_table_index(table, resolved.hash);
+    if (index >= table->size) {
+        return NULL;
+    }
+
+    hash_table_item_t item = frozen_hash_table_slot(table, index);
+    if (table->mode == HASH_TABLE_ADDRESS) {
+        return item.key == resolved.data ? item.value : NULL;
+    }
+
+    int equal = item.value != NULL && item.key_size == resolved.size && (resolved.size == 0 || !memcmp(item.key, resolved.data, resolved.size));
+    return equal ? item.value : NULL;
+}
+
+int frozen_hash_table_contains(const frozen_hash_table_t* table, const void* key)
+{
+    return frozen_hash_table_at(table, key) != NULL;
+}
+
+size_t frozen_hash_table_size(const frozen_hash_table_t* table)
+{
+    return table != NULL ? table->size : 0;
+}
+
+hash_table_item_t frozen_hash_table_item(const frozen_hash_table_t* table, size_t index)
+{
+    hash_table_item_t item;
+    item.key = NULL;
+    item.value = NULL;
+    item.key_size = 0;
+
+    if (index < frozen_hash_table_size(table)) {
+        item = frozen_hash_table_slot(table, index);
+    }
+
+    return item;
+}
+
+void frozen_hash_table_release(frozen_hash_table_t* table)
+{
+    if (table != NULL) {
+        if (table->file != NULL) {
+            frozen_file_unload(table->file, table->file_size);
+        } else {
+            free((void*) table->pilots);
+            free((void*) table->remap);
+        }
+
+        free(table->items);
+        free(table->keys);
+        free(table);
+    }
+}
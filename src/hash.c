@@ -0,0 +1,189 @@
+#include "hash.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+static uint64_t hash_rotl(uint64_t value, int bits)
+{
+    return (value << bits) | (value >> (64 - bits));
+}
+
+static uint64_t hash_read64(const unsigned char* data)
+{
+    uint64_t value;
+    memcpy(&value, data, sizeof(value));
+    return value;
+}
+
+static uint32_t hash_read32(const unsigned char* data)
+{
+    uint32_t value;
+    memcpy(&value, data, sizeof(value));
+    return value;
+}
+
+static uint64_t hash_round(uint64_t acc, uint64_t input)
+{
+    acc += input * XXH_PRIME2;
+    acc = hash_rotl(acc, 31);
+    return acc * XXH_PRIME1;
+}
+
+static uint64_t hash_merge(uint64_t hash, uint64_t acc)
+{
+    hash ^= hash_round(0, acc);
+    return hash * XXH_PRIME1 + XXH_PRIME4;
+}
+
+uint64_t hash_bytes(const void* key, size_t size, uint64_t seed)
+{
+    const unsigned char* data = (const unsigned char*) key;
+    const unsigned char* end = data + size;
+    uint64_t hash;
+
+    if (size >= 32) {
+        uint64_t v1 = seed + XXH_PRIME1 + XXH_PRIME2;
+        uint64_t v2 = seed + XXH_PRIME2;
+        uint64_t v3 = seed;
+        uint64_t v4 = seed - XXH_PRIME1;
+        do {
+            v1 = hash_round(v1, hash_read64(data));
+            v2 = hash_round(v2, hash_read64(data + 8));
+            v3 = hash_round(v3, hash_read64(data + 16));
+            v4 = hash_round(v4, hash_read64(data + 24));
+            data += 32;
+        } while (end - data >= 32);
+
+        hash = hash_rotl(v1, 1) + hash_rotl(v2, 7) + hash_rotl(v3, 12) + hash_rotl(v4, 18);
+        hash = hash_merge(hash, v1);
+        hash = hash_merge(hash, v2);
+        hash = hash_merge(hash, v3);
+        hash = hash_merge(hash, v4);
+    } else {
+        hash = seed + XXH_PRIME5;
+    }
+
+    hash += (uint64_t) size;
+    while (end - data >= 8) {
+        hash ^= hash_round(0, hash_read64(data));
+        hash = hash_rotl(hash, 27) * XXH_PRIME1 + XXH_PRIME4;
+        data += 8;
+    }
+
+    if (end - data >= 4) {
+        hash ^= hash_read32(data) * XXH_PRIME1;
+        hash = hash_rotl(hash, 23) * XXH_PRIME2 + XXH_PRIME3;
+        data += 4;
+    }
+
+    while (data < end) {
+        hash ^= *data++ * XXH_PRIME5;
+        hash = hash_rotl(hash, 11) * XXH_PRIME1;
+    }
+
+    return hash_mix(hash);
+}
+
+static void hash_sip_round(uint64_t v[4])
+{
+    v[0] += v[1];
+    v[1] = hash_rotl(v[1], 13);
+    v[1] ^= v[0];
+    v[0] = hash_rotl(v[0], 32);
+    v[2] += v[3];
+    v[3] = hash_rotl(v[3], 16);
+    v[3] ^= v[2];
+    v[0] += v[3];
+    v[3] = hash_rotl(v[3], 21);
+    v[3] ^= v[0];
+    v[2] += v[1];
+    v[1] = hash_rotl(v[1], 17);
+    v[1] ^= v[2];
+    v[2] = hash_rotl(v[2], 32);
+}
+
+uint64_t hash_keyed(const void* key, size_t size, const uint64_t seed[2])
+{
+    const unsigned char* data = (const unsigned char*) key;
+    const unsigned char* end = data + (size & ~(size_t) 7);
+    uint64_t v[4];
+    v[0] = SIP_INIT0 ^ seed[0];
+    v[1] = SIP_INIT1 ^ seed[1];
+    v[2] = SIP_INIT2 ^ seed[0];
+    v[3] = SIP_INIT3 ^ seed[1];
+
+    for (; data < end; data += 8) {
+        uint64_t block = hash_read64(data);
+        v[3] ^= block;
+        hash_sip_round(v);
+        v[0] ^= block;
+    }
+
+    uint64_t last = (uint64_t) size << 56;
+    for (size_t i = 0; i < (size & 7); i++) {
+        last |= (uint64_t) data[i] << (8 * i);
+    }
+
+    v[3] ^= last;
+    hash_sip_round(v);
+    v[0] ^= last;
+
+    v[2] ^= 0xff;
+    hash_sip_round(v);
+    hash_sip_round(v);
+    hash_sip_round(v);
+    return v[0] ^ v[1] ^ v[2] ^ v[3];
+}
+
+void hash_random_seed(uint64_t seed[2])
+{
+    FILE* file = fopen("/dev/urandom", "rb");
+    if (file != NULL) {
+        size_t read = fread(seed, sizeof(uint64_t), 2, file);
+        fclose(file);
+        if (read == 2) {
+            return;
+        }
+    }
+
+    struct timespec now;
+    if (timespec_get(&now, TIME_UTC) == 0) {
+        now.tv_sec = time(NULL);
+        now.tv_nsec = 0;
+    }
+
+    uint64_t entropy = (uint64_t) now.tv_sec * 1000000000 + (uint64_t) now.tv_nsec;
+    entropy ^= hash_address(seed) ^ hash_address(&now) ^ (uint64_t) clock();
+    seed[0] = hash_mix(entropy + FIBONACCI);
+    seed[1] = hash_mix(entropy + 2 * FIBONACCI);
+}
+
+size_t hash_round_capacity(size_t capacity, size_t minimum)
+{
+    size_t rounded = minimum;
+    while (rounded < capacity) {
+        if (rounded > SIZE_MAX / 2) {
+            return 0;
+        }
+
+        rounded *= 2;
+    }
+
+    return rounded;
+}
+
+size_t hash_fit_capacity(size_t size, double max_load_factor, size_t minimum)
+{
+    double capacity = (double) size / max_load_factor;
+    if (!(capacity < (double) SIZE_MAX)) {
+        return 0;
+    }
+
+    size_t rounded = (size_t) capacity;
+    if ((double) rounded < capacity) {
+        rounded++;
+    }
+
+    return hash_round_capacity(rounded, minimum);
+}
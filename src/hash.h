@@ -0,0 +1,135 @@
+#pragma once
+
+#include "marlo/hash_table.h"
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#define FIBONACCI UINT64_C(0x9e3779b97f4a7c15)
+#define XXH_PRIME1 UINT64_C(0x9e3779b185ebca87)
+#define XXH_PRIME2 UINT64_C(0xc2b2ae3d27d4eb4f)
+#define XXH_PRIME3 UINT64_C(0x165667b19e3779f9)
+#define XXH_PRIME4 UINT64_C(0x85ebca77c2b2ae63)
+#define XXH_PRIME5 UINT64_C(0x27d4eb2f165667c5)
+#define SIP_INIT0 UINT64_C(0x736f6d6570736575)
+#define SIP_INIT1 UINT64_C(0x646f72616e646f6d)
+#define SIP_INIT2 UINT64_C(0x6c7967656e657261)
+#define SIP_INIT3 UINT64_C(0x7465646279746573)
+
+/**
+ * Fibonacci hashing for addresses.
+ * Like every hash below, the top bits of the result are the well mixed ones,
+ * so containers index their slots with them.
+ */
+static inline uint64_t hash_address(const void* key)
+{
+    return (uint64_t) (uintptr_t) key * FIBONACCI;
+}
+
+/**
+ * xxHash64 avalanche, spreads every input bit over the whole result.
+ */
+static inline uint64_t hash_mix(uint64_t hash)
+{
+    hash ^= hash >> 33;
+    hash *= XXH_PRIME2;
+    hash ^= hash >> 29;
+    hash *= XXH_PRIME3;
+    hash ^= hash >> 32;
+    return hash;
+}
+
+/**
+ * Maps the hash to `[0, range)` by taking the high 64 bits of
+ * `hash * range`, which relies on the top bits of the hash only and costs a
+ * multiplication instead of the division of `hash % range`.
+ */
+static inline uint64_t hash_range(uint64_t hash, uint64_t range)
+{
+#if defined(__SIZEOF_INT128__)
+    __extension__ typedef unsigned __int128 hash_uint128_t;
+    return (uint64_t) (((hash_uint128_t) hash * range) >> 64);
+#else
+    uint64_t lo_lo = (hash & 0xffffffff) * (range & 0xffffffff);
+    uint64_t hi_lo = (hash >> 32) * (range & 0xffffffff);
+    uint64_t lo_hi = (hash & 0xffffffff) * (range >> 32);
+    uint64_t hi_hi = (hash >> 32) * (range >> 32);
+    uint64_t cross = (lo_lo >> 32) + (hi_lo & 0xffffffff) + lo_hi;
+    return hi_hi + (hi_lo >> 32) + (cross >> 32);
+#endif
+}
+
+/**
+ * Key resolved once per call: the bytes to hash/compare and the full hash.
+ * `data` is the key itself in address and custom modes.
+ */
+typedef struct hash_key_t {
+    const void* data;
+    size_t size;
+    uint64_t hash;
+} hash_key_t;
+
+/**
+ * Resolves the data and size of the given key for the given mode, modes
+ * other than `HASH_TABLE_STRING` and `HASH_TABLE_BYTES` taking the key
+ * itself.
+ * The hash is left to the caller, every container hashes keys its own way.
+ * Returns 0 on success or -1 on error (invalid key).
+ */
+static inline int hash_key_resolve(int mode, const void* key, hash_key_t* out)
+{
+    if (mode == HASH_TABLE_STRING) {
+        if (key == NULL) {
+            return -1;
+        }
+
+        out->data = key;
+        out->size = strlen((const char*) key);
+    } else if (mode == HASH_TABLE_BYTES) {
+        const hash_table_bytes_t* bytes = (const hash_table_bytes_t*) key;
+        if (bytes == NULL || (bytes->data == NULL && bytes->size > 0)) {
+            return -1;
+        }
+
+        out->data = bytes->data;
+        out->size = bytes->size;
+    } else {
+        out->data = key;
+        out->size = 0;
+    }
+
+    return 0;
+}
+
+/**
+ * Rounds the given capacity up to a power of two no smaller than `minimum`,
+ * itself a power of two.
+ * Returns 0 on overflow.
+ */
+size_t hash_round_capacity(size_t capacity, size_t minimum);
+
+/**
+ * Returns the smallest power of two capacity, no smaller than `minimum`,
+ * holding `size` elements without exceeding the given load factor.
+ * Returns 0 on overflow.
+ */
+size_t hash_fit_capacity(size_t size, double max_load_factor, size_t minimum);
+
+/**
+ * xxHash64 over the given bytes.
+ * Consumes 32 bytes per step with four independent lanes.
+ */
+uint64_t hash_bytes(const void* key, size_t size, uint64_t seed);
+
+/**
+ * SipHash-1-3 over the given bytes, keyed with the 128 bits of `seed`.
+ * Slower than `hash_bytes()`, but collisions can't be found without knowing
+ * the key, so it's meant for keys chosen by untrusted parties.
+ */
+uint64_t hash_keyed(const void* key, size_t size, const uint64_t seed[2]);
+
+/**
+ * Fills `seed` with random bits, from the system's random source if any,
+ * otherwise from the current time and a few addresses.
+ */
+void hash_random_seed(uint64_t seed[2]);
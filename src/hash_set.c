@@ -1,36 +1,249 @@
 #include "marlo/hash_set.h"
 #include "marlo/hash_table.h"
+#include "hash.h"
 
+#include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
 
+#define RESIZE_FACTOR 2
+#define MAX_LOAD_FACTOR 0.75
+#define MIN_CAPACITY 8
+
+/**
+ * Flat power of two array of elements, empty slots are `NULL`.
+ * Elements are linearly probed from the home slot given by the top bits of
+ * their hash, removals move the following elements back so no tombstones
+ * are needed.
+ * Each set hashes with its own `seed`, otherwise adding the elements of a
+ * set to a smaller one in iteration order (hash order) would pile them up
+ * into a single cluster.
+ * In string mode `tags` holds the low byte of each element's hash, right
+ * after `values` in the same block, so most strings that don't match are
+ * skipped without being read.
+ */
 struct hash_set_t {
-    hash_table_t* values;
+    int mode;
+    const void** values;
+    unsigned char* tags;
+    size_t capacity;
+    size_t size;
+    int shift;
+    uint64_t seed;
 };
 
+static size_t hash_set_max_size(size_t capacity)
+{
+    return (size_t) ((double) capacity * MAX_LOAD_FACTOR);
+}
+
+static uint64_t hash_set_hash(const hash_set_t* set, const void* value)
+{
+    if (set->mode == HASH_TABLE_STRING) {
+        return hash_bytes(value, strlen((const char*) value), set->seed);
+    }
+
+    return ((uint64_t) (uintptr_t) value ^ set->seed) * FIBONACCI;
+}
+
+static size_t hash_set_home(const hash_set_t* set, uint64_t hash)
+{
+    return (size_t) (hash >> set->shift);
+}
+
+static size_t hash_set_following(const hash_set_t* set, size_t pos)
+{
+    return (pos + 1) & (set->capacity - 1);
+}
+
+/**
+ * Returns the slot holding the given value, of the given hash, or `NULL` if
+ * not found.
+ */
+static const void** hash_set_find(const hash_set_t* set, const void* value, uint64_t hash)
+{
+    size_t pos = hash_set_home(set, hash);
+    if (set->tags == NULL) {
+        while (set->values[pos] != NULL) {
+            if (set->values[pos] == value) {
+                return &set->values[pos];
+            }
+
+            pos = hash_set_following(set, pos);
+        }
+
+        return NULL;
+    }
+
+    while (set->values[pos] != NULL) {
+        if (set->tags[pos] == (unsigned char) hash && !strcmp((const char*) set->values[pos], (const char*) value)) {
+            return &set->values[pos];
+        }
+
+        pos = hash_set_following(set, pos);
+    }
+
+    return NULL;
+}
+
+/**
+ * Stores a value known not to be in the set, which must have room for it.
+ */
+static void hash_set_place(hash_set_t* set, const void* value, uint64_t hash)
+{
+    size_t pos = hash_set_home(set, hash);
+    while (set->values[pos] != NULL) {
+        pos = hash_set_following(set, pos);
+    }
+
+    set->values[pos] = value;
+    if (set->tags != NULL) {
+        set->tags[pos] = (unsigned char) hash;
+    }
+
+    set->size++;
+}
+
+/**
+ * Whether the set contains the given value, hashed for the set.
+ */
+static int hash_set_has(const hash_set_t* set, const void* value)
+{
+    return set->size > 0 && hash_set_find(set, value, hash_set_hash(set, value)) != NULL;
+}
+
+/**
+ * Moves the elements into a new array of the given capacity, which must be a
+ * power of two able to hold them.
+ * Returns 0 on success or -1 on error, in which case the set is unchanged.
+ */
+static int hash_set_resize(hash_set_t* set, size_t capacity)
+{
+    size_t tag_size = set->mode == HASH_TABLE_STRING ? 1 : 0;
+    const void** values = (const void**) calloc(capacity, sizeof(const void*) + tag_size);
+    if (values == NULL) {
+        return -1;
+    }
+
+    int shift = 64;
+    for (size_t i = capacity; i > 1; i >>= 1) {
+        shift--;
+    }
+
+    const void** old_values = set->values;
+    size_t old_capacity = set->capacity;
+    set->values = values;
+    set->tags = tag_size > 0 ? (unsigned char*) (values + capacity) : NULL;
+    set->capacity = capacity;
+    set->size = 0;
+    set->shift = shift;
+
+    for (size_t i = 0; i < old_capacity; i++) {
+        if (old_values[i] != NULL) {
+            hash_set_place(set, old_values[i], hash_set_hash(set, old_values[i]));
+        }
+    }
+
+    free(old_values);
+    return 0;
+}
+
 hash_set_t* hash_set_new(size_t capacity)
 {
+    return hash_set_new_mode(HASH_TABLE_ADDRESS, capacity);
+}
+
+hash_set_t* hash_set_new_mode(int mode, size_t capacity)
+{
+    if (mode != HASH_TABLE_ADDRESS && mode != HASH_TABLE_STRING) {
+        return NULL;
+    }
+
     hash_set_t* set = (hash_set_t*) malloc(sizeof(hash_set_t));
     if (set == NULL) {
         return NULL;
     }
 
-    hash_table_t* values = hash_table_new(HASH_TABLE_ADDRESS, capacity);
-    if (values == NULL) {
-        free(set);
-        return NULL;
+    set->mode = mode;
+    set->values = NULL;
+    set->tags = NULL;
+    set->capacity = 0;
+    set->size = 0;
+    set->shift = 64;
+    set->seed = hash_address(set);
+
+    if (capacity > 0) {
+        capacity = hash_round_capacity(capacity, MIN_CAPACITY);
+        if (capacity == 0 || hash_set_resize(set, capacity) == -1) {
+            free(set);
+            return NULL;
+        }
     }
 
-    set->values = values;
     return set;
 }
 
+/**
+ * Returns a new set holding the elements of the given one, with at least the
+ * given capacity, or `NULL` on error.
+ * The array is copied as is when the capacities match.
+ */
+static hash_set_t* hash_set_copy(const hash_set_t* set, size_t capacity)
+{
+    if (capacity < set->capacity) {
+        capacity = set->capacity;
+    }
+
+    hash_set_t* copy = hash_set_new_mode(set->mode, capacity);
+    if (copy == NULL || set->size == 0) {
+        return copy;
+    }
+
+    copy->seed = set->seed;
+    if (copy->capacity == set->capacity) {
+        memcpy(copy->values, set->values, set->capacity * (sizeof(const void*) + (set->tags != NULL ? 1 : 0)));
+        copy->size = set->size;
+        return copy;
+    }
+
+    for (size_t i = 0; i < set->capacity; i++) {
+        if (set->values[i] != NULL) {
+            hash_set_place(copy, set->values[i], hash_set_hash(copy, set->values[i]));
+        }
+    }
+
+    return copy;
+}
+
+int hash_set_mode(const hash_set_t* set)
+{
+    return set != NULL ? set->mode : -1;
+}
+
 int hash_set_push(hash_set_t* set, const void* value)
 {
-    if (set == NULL) {
+    if (set == NULL || value == NULL) {
         return -1;
     }
 
-    return hash_table_push(set->values, value, value);
+    uint64_t hash = hash_set_hash(set, value);
+    if (set->size > 0 && hash_set_find(set, value, hash) != NULL) {
+        return 0;
+    }
+
+    if (set->size + 1 > hash_set_max_size(set->capacity)) {
+        if (set->capacity > SIZE_MAX / RESIZE_FACTOR) {
+            return -1;
+        }
+
+        size_t capacity = set->capacity > 0 ? set->capacity * RESIZE_FACTOR : MIN_CAPACITY;
+        if (hash_set_resize(set, capacity) == -1) {
+            return -1;
+        }
+    }
+
+    hash_set_place(set, value, hash);
+    return 0;
 }
 
 int hash_set_is_empty(const hash_set_t* set)
@@ -40,7 +253,30 @@ int hash_set_is_empty(const hash_set_t* set)
 
 int hash_set_contains(const hash_set_t* set, const void* value)
 {
-    return set != NULL && hash_table_contains(set->values, value);
+    return set != NULL && value != NULL && hash_set_has(set, value);
+}
+
+/**
+ * Returns an iterator pointing to the first element at or after the given
+ * position or a `NULL`ed/zero struct if there's none.
+ */
+static hash_set_iterator_t hash_set_seek(const hash_set_t* set, size_t pos)
+{
+    hash_set_iterator_t iter;
+    iter.set = NULL;
+    iter.pos = 0;
+    iter.node = NULL;
+
+    for (; pos < set->capacity; pos++) {
+        if (set->values[pos] != NULL) {
+            iter.set = set;
+            iter.pos = pos;
+            iter.node = &set->values[pos];
+            break;
+        }
+    }
+
+    return iter;
 }
 
 hash_set_iterator_t hash_set_begin(const hash_set_t* set)
@@ -51,10 +287,7 @@ hash_set_iterator_t hash_set_begin(const hash_set_t* set)
     iter.node = NULL;
 
     if (hash_set_size(set) > 0) {
-        hash_table_iterator_t inner = hash_table_begin(set->values);
-        iter.set = set;
-        iter.pos = inner.pos;
-        iter.node = inner.node;
+        iter = hash_set_seek(set, 0);
     }
 
     return iter;
@@ -73,17 +306,7 @@ hash_set_iterator_t hash_set_next(hash_set_iterator_t iter)
     next.node = NULL;
 
     if (iter.set != NULL) {
-        hash_table_iterator_t inner;
-        inner.table = iter.set->values;
-        inner.pos = iter.pos;
-        inner.node = iter.node;
-
-        inner = hash_table_next(inner);
-        if (hash_table_is_valid(inner)) {
-            next.set = iter.set;
-            next.pos = inner.pos;
-            next.node = inner.node;
-        }
+        next = hash_set_seek(iter.set, iter.pos + 1);
     }
 
     return next;
@@ -91,48 +314,180 @@ hash_set_iterator_t hash_set_next(hash_set_iterator_t iter)
 
 const void* hash_set_value(hash_set_iterator_t iter)
 {
-    hash_table_iterator_t inner;
-    inner.table = iter.set != NULL ? iter.set->values : NULL;
-    inner.pos = iter.pos;
-    inner.node = iter.node;
+    return iter.node != NULL ? *(const void* const*) iter.node : NULL;
+}
+
+/**
+ * Empties the slot at the given position, moving back every following
+ * element of the cluster whose home slot allows it.
+ */
+static void hash_set_erase(hash_set_t* set, size_t pos)
+{
+    size_t next = hash_set_following(set, pos);
+    while (set->values[next] != NULL) {
+        size_t home = hash_set_home(set, hash_set_hash(set, set->values[next]));
+        if (((next - home) & (set->capacity - 1)) >= ((next - pos) & (set->capacity - 1))) {
+            set->values[pos] = set->values[next];
+            if (set->tags != NULL) {
+                set->tags[pos] = set->tags[next];
+            }
+
+            pos = next;
+        }
 
-    hash_table_item_t item = hash_table_item(inner);
-    return item.value;
+        next = hash_set_following(set, next);
+    }
+
+    set->values[pos] = NULL;
+    set->size--;
 }
 
 void hash_set_remove(hash_set_t* set, const void* value)
 {
-    if (set != NULL) {
-        hash_table_remove(set->values, value);
+    const void** slot = hash_set_size(set) > 0 && value != NULL ? hash_set_find(set, value, hash_set_hash(set, value)) : NULL;
+    if (slot != NULL) {
+        hash_set_erase(set, (size_t) (slot - set->values));
     }
 }
 
+hash_set_t* hash_set_union(const hash_set_t* set, const hash_set_t* other)
+{
+    if (set == NULL || other == NULL || set->mode != other->mode) {
+        return NULL;
+    }
+
+    if (set->size < other->size) {
+        const hash_set_t* tmp = set;
+        set = other;
+        other = tmp;
+    }
+
+    if (set->size > SIZE_MAX - other->size) {
+        return NULL;
+    }
+
+    size_t capacity = hash_fit_capacity(set->size + other->size, MAX_LOAD_FACTOR, MIN_CAPACITY);
+    hash_set_t* result = capacity > 0 ? hash_set_copy(set, capacity) : NULL;
+    if (result == NULL) {
+        return NULL;
+    }
+
+    for (size_t i = 0; i < other->capacity; i++) {
+        const void* value = other->values[i];
+        if (value != NULL) {
+            uint64_t hash = hash_set_hash(result, value);
+            if (hash_set_find(result, value, hash) == NULL) {
+                hash_set_place(result, value, hash);
+            }
+        }
+    }
+
+    return result;
+}
+
+hash_set_t* hash_set_intersect(const hash_set_t* set, const hash_set_t* other)
+{
+    if (set == NULL || other == NULL || set->mode != other->mode) {
+        return NULL;
+    }
+
+    if (set->size > other->size) {
+        const hash_set_t* tmp = set;
+        set = other;
+        other = tmp;
+    }
+
+    hash_set_t* result = hash_set_new_mode(set->mode, set->size > 0 ? hash_fit_capacity(set->size, MAX_LOAD_FACTOR, MIN_CAPACITY) : 0);
+    if (result == NULL) {
+        return NULL;
+    }
+
+    for (size_t i = 0; i < set->capacity && other->size > 0; i++) {
+        const void* value = set->values[i];
+        if (value != NULL && hash_set_has(other, value)) {
+            hash_set_place(result, value, hash_set_hash(result, value));
+        }
+    }
+
+    return result;
+}
+
+hash_set_t* hash_set_difference(const hash_set_t* set, const hash_set_t* other)
+{
+    if (set == NULL || other == NULL || set->mode != other->mode) {
+        return NULL;
+    }
+
+    if (other->size < set->size) {
+        hash_set_t* result = hash_set_copy(set, 0);
+        for (size_t i = 0; result != NULL && i < other->capacity; i++) {
+            if (other->values[i] != NULL) {
+                hash_set_remove(result, other->values[i]);
+            }
+        }
+
+        return result;
+    }
+
+    hash_set_t* result = hash_set_new_mode(set->mode, set->size > 0 ? hash_fit_capacity(set->size, MAX_LOAD_FACTOR, MIN_CAPACITY) : 0);
+    if (result == NULL) {
+        return NULL;
+    }
+
+    for (size_t i = 0; i < set->capacity; i++) {
+        const void* value = set->values[i];
+        if (value != NULL && !hash_set_has(other, value)) {
+            hash_set_place(result, value, hash_set_hash(result, value));
+        }
+    }
+
+    return result;
+}
+
+int hash_set_reserve(hash_set_t* set, size_t size)
+{
+    if (set == NULL) {
+        return -1;
+    }
+
+    size_t capacity = hash_fit_capacity(size, MAX_LOAD_FACTOR, MIN_CAPACITY);
+    if (capacity == 0) {
+        return -1;
+    }
+
+    return capacity > set->capacity ? hash_set_resize(set, capacity) : 0;
+}
+
 void hash_set_clear(hash_set_t* set)
 {
     if (set != NULL) {
-        hash_table_clear(set->values);
+        for (size_t i = 0; i < set->capacity; i++) {
+            set->values[i] = NULL;
+        }
+
+        set->size = 0;
     }
 }
 
 size_t hash_set_size(const hash_set_t* set)
 {
-    return set != NULL ? hash_table_size(set->values) : 0;
+    return set != NULL ? set->size : 0;
 }
 
 size_t hash_set_capacity(const hash_set_t* set)
 {
-    return set != NULL ? hash_table_capacity(set->values) : 0;
+    return set != NULL ? set->capacity : 0;
 }
 
 float hash_set_load_factor(const hash_set_t* set)
 {
-    return set != NULL ? hash_table_load_factor(set->values) : 0;
+    return hash_set_capacity(set) > 0 ? (float) set->size / (float) set->capacity : 0;
 }
 
 void hash_set_release(hash_set_t* set)
 {
     if (set != NULL) {
-        hash_table_release(set->values);
+        free(set->values);
         free(set);
     }
 }
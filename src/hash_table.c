@@ -1,317 +1,1091 @@
 #include "marlo/hash_table.h"
+#include "arena.h"
+#include "hash.h"
 
 #include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 
 #define RESIZE_FACTOR 2
 #define MAX_LOAD_FACTOR 0.75
+#define MIN_LOAD_FACTOR 0.125
+#define MIN_CAPACITY 16
+#define SMALL_SIZE 8
+#define MODE_MASK 0xff
+#define FLAGS_MASK (HASH_TABLE_INCREMENTAL | HASH_TABLE_AUTO_SHRINK | HASH_TABLE_OWN_KEYS | HASH_TABLE_KEYED)
+#define BYTES_FLAGS (HASH_TABLE_OWN_KEYS | HASH_TABLE_KEYED)
+#define MIGRATE_STEP 4
+#define MIGRATE_EMPTY_VISITS 10
+#define COMPACT_STEP 8
+#define MAX_PROBE_DISTANCE 64
+#define BATCH_SIZE 16
+#define GENERATION_MASK UINT64_C(0xffff)
+
+#if defined(__GNUC__)
+#define PREFETCH(address) __builtin_prefetch(address)
+#else
+#define PREFETCH(address) ((void) (address))
+#endif
 
-typedef struct list_node_t list_node_t;
-
-struct list_node_t {
+/**
+ * Dense entry, removed if `item.value` is `NULL`.
+ * `hash` caches the full hash of the key, so keys are never hashed twice.
+ */
+typedef struct hash_entry_t {
     hash_table_item_t item;
-    list_node_t* next;
-};
+    uint64_t hash;
+} hash_entry_t;
 
-typedef struct linked_list_t {
-    list_node_t* head;
-    size_t size;
-} linked_list_t;
+/**
+ * Open addressing index slot, empty if `entry` is 0 or if it belongs to an
+ * older generation, otherwise it refers to the entry at `entry - 1`.
+ * The hash is repeated here so probing only touches the entries on a match,
+ * its low bits replaced by the generation of the slot.
+ */
+typedef struct hash_slot_t {
+    size_t entry;
+    uint64_t hash;
+} hash_slot_t;
+
+/**
+ * Power of two array of index slots.
+ * The home slot of a key is given by the top bits of its hash, so bucket
+ * indexing is a shift instead of a division.
+ * Only the slots of the current `generation` are in use, so all of them are
+ * emptied at once by moving to the next one.
+ */
+typedef struct hash_slots_t {
+    hash_slot_t* items;
+    size_t capacity;
+    int shift;
+    uint64_t generation;
+} hash_slots_t;
 
+/**
+ * Entries are stored in insertion order, `entries_size` of them are in use,
+ * removed ones included, until the array is compacted.
+ * `slots` indexes the live entries, `entries_capacity` is the number of
+ * entries it can index without exceeding the max load factor.
+ * While an incremental rehash is in progress, `old_slots` holds the index
+ * slots that haven't been migrated yet and `migrate_pos` is the migration
+ * cursor. Every slot before the cursor is empty.
+ * While an incremental compaction is in progress (`compacting` is set), the
+ * live entries at `compact_read` and after are moved down to `compact_write`
+ * a few at a time, so the entries in between are all removed ones.
+ * In `HASH_TABLE_OWN_KEYS` mode keys are copied into `keys`, `key_bytes` of
+ * which belong to live entries.
+ * `rehashes` and `rehash_time` (in nanoseconds) are kept for
+ * `hash_table_stats()`.
+ * String and bytes keys are hashed with `hash_keyed()` and `seed` once
+ * `keyed` is set.
+ * Up to `SMALL_SIZE` entries are kept in `small`, inside the table itself,
+ * and searched linearly, without any index (`slots.items` is `NULL`).
+ */
 struct hash_table_t {
     int mode;
-    linked_list_t** items;
-    size_t capacity;
+    int flags;
+    hash_table_hash_t hash;
+    hash_table_equals_t equals;
+    void* ctx;
+    hash_entry_t* entries;
+    size_t entries_size;
+    size_t entries_capacity;
+    hash_slots_t slots;
     size_t size;
+    hash_slots_t old_slots;
+    size_t old_size;
+    size_t migrate_pos;
+    int compacting;
+    size_t compact_read;
+    size_t compact_write;
+    arena_t keys;
+    size_t key_bytes;
+    size_t rehashes;
+    uint64_t rehash_time;
+    uint64_t seed[2];
+    int keyed;
+    hash_entry_t small[SMALL_SIZE];
 };
 
-hash_table_t* hash_table_new(int mode, size_t capacity)
+/**
+ * Returns the number of entries an index of the given capacity can hold
+ * without exceeding the max load factor.
+ */
+static size_t hash_table_max_size(size_t capacity)
+{
+    return (size_t) ((double) capacity * MAX_LOAD_FACTOR);
+}
+
+/**
+ * Reallocates the entries array to the given capacity, moving the entries
+ * back into `small` if they fit.
+ * Failing to shrink it isn't an error, the larger array is just kept.
+ * Returns 0 on success or -1 on error.
+ */
+static int hash_table_realloc_entries(hash_table_t* table, size_t capacity)
+{
+    if (capacity <= SMALL_SIZE) {
+        if (table->entries != table->small) {
+            memcpy(table->small, table->entries, table->entries_size * sizeof(hash_entry_t));
+            free(table->entries);
+            table->entries = table->small;
+        }
+
+        table->entries_capacity = SMALL_SIZE;
+        return 0;
+    }
+
+    if (capacity > SIZE_MAX / sizeof(hash_entry_t)) {
+        return -1;
+    }
+
+    hash_entry_t* entries = NULL;
+    if (table->entries == table->small) {
+        entries = (hash_entry_t*) malloc(capacity * sizeof(hash_entry_t));
+        if (entries != NULL) {
+            memcpy(entries, table->small, table->entries_size * sizeof(hash_entry_t));
+        }
+    } else {
+        entries = (hash_entry_t*) realloc(table->entries, capacity * sizeof(hash_entry_t));
+    }
+
+    if (entries == NULL) {
+        if (capacity > table->entries_capacity) {
+            return -1;
+        }
+
+        entries = table->entries;
+    }
+
+    table->entries = entries;
+    table->entries_capacity = capacity;
+    return 0;
+}
+
+/**
+ * Allocates a power of two array of empty slots.
+ * `calloc()` is used so large arrays come straight from zeroed pages instead
+ * of being touched up front, which would defeat incremental rehashing.
+ * Returns 0 on success or -1 on error.
+ */
+static int hash_slots_init(hash_slots_t* slots, size_t capacity)
+{
+    hash_slot_t* items = (hash_slot_t*) calloc(capacity, sizeof(hash_slot_t));
+    if (items == NULL) {
+        return -1;
+    }
+
+    int shift = 64;
+    for (size_t i = capacity; i > 1; i >>= 1) {
+        shift--;
+    }
+
+    slots->items = items;
+    slots->capacity = capacity;
+    slots->shift = shift;
+    slots->generation = 0;
+    return 0;
+}
+
+static void hash_slots_reset(hash_slots_t* slots)
+{
+    free(slots->items);
+    slots->items = NULL;
+    slots->capacity = 0;
+    slots->shift = 64;
+    slots->generation = 0;
+}
+
+/**
+ * Empties every slot by moving to the next generation.
+ * The slots are only actually cleared once the generations wrap around.
+ */
+static void hash_slots_clear(hash_slots_t* slots)
+{
+    slots->generation = (slots->generation + 1) & GENERATION_MASK;
+    if (slots->generation == 0) {
+        for (size_t i = 0; i < slots->capacity; i++) {
+            slots->items[i].entry = 0;
+            slots->items[i].hash = 0;
+        }
+    }
+}
+
+/**
+ * Returns the given hash as stored in the slots of the current generation.
+ */
+static uint64_t hash_slots_tag(const hash_slots_t* slots, uint64_t hash)
+{
+    return (hash & ~GENERATION_MASK) | slots->generation;
+}
+
+static int hash_slots_used(const hash_slots_t* slots, size_t pos)
+{
+    return slots->items[pos].entry != 0 && (slots->items[pos].hash & GENERATION_MASK) == slots->generation;
+}
+
+static size_t hash_slots_home(const hash_slots_t* slots, uint64_t hash)
+{
+    return (size_t) (hash >> slots->shift);
+}
+
+static size_t hash_slots_next(const hash_slots_t* slots, size_t pos)
+{
+    return (pos + 1) & (slots->capacity - 1);
+}
+
+/**
+ * Returns the probe distance of the slot at the given position from the home
+ * slot of its key.
+ */
+static size_t hash_slots_distance(const hash_slots_t* slots, size_t pos)
+{
+    return (pos - hash_slots_home(slots, slots->items[pos].hash)) & (slots->capacity - 1);
+}
+
+static hash_table_t* hash_table_new_impl(int mode, int flags, size_t capacity)
+{
+    if ((flags & ~FLAGS_MASK) != 0) {
+        return NULL;
+    }
+
+    if ((flags & BYTES_FLAGS) && mode != HASH_TABLE_STRING && mode != HASH_TABLE_BYTES) {
+        return NULL;
+    }
+
+    hash_table_t* table = (hash_table_t*) malloc(sizeof(hash_table_t));
+    if (table == NULL) {
+        return NULL;
+    }
+
+    table->mode = mode;
+    table->flags = flags;
+    table->hash = NULL;
+    table->equals = NULL;
+    table->ctx = NULL;
+    table->entries = table->small;
+    table->entries_size = 0;
+    table->entries_capacity = SMALL_SIZE;
+    table->slots.items = NULL;
+    table->slots.capacity = 0;
+    table->slots.shift = 64;
+    table->slots.generation = 0;
+    table->size = 0;
+    table->old_slots = table->slots;
+    table->old_size = 0;
+    table->migrate_pos = 0;
+    table->compacting = 0;
+    table->compact_read = 0;
+    table->compact_write = 0;
+    arena_init(&table->keys);
+    table->key_bytes = 0;
+    table->rehashes = 0;
+    table->rehash_time = 0;
+    table->seed[0] = 0;
+    table->seed[1] = 0;
+    table->keyed = 0;
+
+    if (flags & HASH_TABLE_KEYED) {
+        hash_random_seed(table->seed);
+        table->keyed = 1;
+    }
+
+    if (capacity > SMALL_SIZE) {
+        capacity = hash_round_capacity(capacity, MIN_CAPACITY);
+        if (capacity == 0 || hash_slots_init(&table->slots, capacity) == -1) {
+            free(table);
+            return NULL;
+        }
+
+        if (hash_table_realloc_entries(table, hash_table_max_size(capacity)) == -1) {
+            free(table->slots.items);
+            free(table);
+            return NULL;
+        }
+    }
+
+    return table;
+}
+
+hash_table_t* hash_table_new(int mode, size_t capacity)
+{
+    int flags = mode & ~MODE_MASK;
+    mode &= MODE_MASK;
+    if (mode != HASH_TABLE_ADDRESS && mode != HASH_TABLE_STRING && mode != HASH_TABLE_BYTES) {
+        return NULL;
+    }
+
+    return hash_table_new_impl(mode, flags, capacity);
+}
+
+hash_table_t* hash_table_new_custom(int flags, size_t capacity, hash_table_hash_t hash, hash_table_equals_t equals, void* ctx)
+{
+    if (hash == NULL || equals == NULL) {
+        return NULL;
+    }
+
+    hash_table_t* table = hash_table_new_impl(HASH_TABLE_CUSTOM, flags, capacity);
+    if (table == NULL) {
+        return NULL;
+    }
+
+    table->hash = hash;
+    table->equals = equals;
+    table->ctx = ctx;
+    return table;
+}
+
+int hash_table_mode(const hash_table_t* table)
+{
+    if (table == NULL) {
+        return -1;
+    }
+
+    return table->mode;
+}
+
+int hash_table_flags(const hash_table_t* table)
+{
+    if (table == NULL) {
+        return -1;
+    }
+
+    return table->flags;
+}
+
+int hash_table_is_address(const hash_table_t* table)
+{
+    return hash_table_mode(table) == HASH_TABLE_ADDRESS;
+}
+
+int hash_table_is_string(const hash_table_t* table)
+{
+    return hash_table_mode(table) == HASH_TABLE_STRING;
+}
+
+int hash_table_is_bytes(const hash_table_t* table)
+{
+    return hash_table_mode(table) == HASH_TABLE_BYTES;
+}
+
+int hash_table_is_custom(const hash_table_t* table)
+{
+    return hash_table_mode(table) == HASH_TABLE_CUSTOM;
+}
+
+int hash_table_is_keyed(const hash_table_t* table)
+{
+    return table != NULL && table->keyed;
+}
+
+int hash_table_is_rehashing(const hash_table_t* table)
+{
+    return table != NULL && table->old_slots.items != NULL;
+}
+
+/**
+ * Robin Hood insertion of a key known not to be in `slots`.
+ * Richer slots (shorter probe distance) are handed over to the carried entry.
+ * Returns the longest probe distance an entry was placed at, the new key's
+ * own distance unless a displaced entry ended up further from its home.
+ */
+static size_t hash_slots_place(hash_slots_t* slots, size_t entry, uint64_t hash)
+{
+    size_t pos = hash_slots_home(slots, hash);
+    size_t distance = 0;
+    size_t longest = 0;
+    hash = hash_slots_tag(slots, hash);
+    while (hash_slots_used(slots, pos)) {
+        size_t slot_distance = hash_slots_distance(slots, pos);
+        if (slot_distance < distance) {
+            longest = distance > longest ? distance : longest;
+            hash_slot_t tmp = slots->items[pos];
+            slots->items[pos].entry = entry;
+            slots->items[pos].hash = hash;
+            entry = tmp.entry;
+            hash = tmp.hash;
+            distance = slot_distance;
+        }
+
+        pos = hash_slots_next(slots, pos);
+        distance++;
+    }
+
+    slots->items[pos].entry = entry;
+    slots->items[pos].hash = hash;
+    return distance > longest ? distance : longest;
+}
+
+/**
+ * Empties the slot at the given position using backward shift deletion, so
+ * no tombstones are left behind.
+ */
+static void hash_slots_erase(hash_slots_t* slots, size_t pos)
+{
+    size_t next = hash_slots_next(slots, pos);
+    while (hash_slots_used(slots, next) && hash_slots_distance(slots, next) > 0) {
+        slots->items[pos] = slots->items[next];
+        pos = next;
+        next = hash_slots_next(slots, pos);
+    }
+
+    slots->items[pos].entry = 0;
+    slots->items[pos].hash = 0;
+}
+
+/**
+ * Returns the slot in `slots` referring to the entry at the given position
+ * or `NULL` if not found.
+ * The entry's cached hash leads to it, so keys are neither hashed nor
+ * compared.
+ */
+static hash_slot_t* hash_table_probe_entry(const hash_table_t* table, const hash_slots_t* slots, size_t pos)
+{
+    uint64_t hash = table->entries[pos].hash;
+    size_t slot = hash_slots_home(slots, hash);
+    size_t distance = 0;
+    while (hash_slots_used(slots, slot) && hash_slots_distance(slots, slot) >= distance) {
+        if (slots->items[slot].entry == pos + 1) {
+            return &slots->items[slot];
+        }
+
+        slot = hash_slots_next(slots, slot);
+        distance++;
+    }
+
+    return NULL;
+}
+
+/**
+ * Moves up to `count` slots from the old array into the current one, visiting
+ * a bounded number of empty slots on the way.
+ * The old array is released once it's been drained.
+ * Removing at the cursor shifts the following slots back, so the old array
+ * stays a valid table and can still be probed until it's gone.
+ */
+static void hash_table_migrate(hash_table_t* table, size_t count)
+{
+    size_t empty_visits = count < SIZE_MAX / MIGRATE_EMPTY_VISITS ? count * MIGRATE_EMPTY_VISITS : SIZE_MAX;
+    while (table->old_size > 0 && count > 0 && table->migrate_pos < table->old_slots.capacity) {
+        hash_slot_t* slot = &table->old_slots.items[table->migrate_pos];
+        if (!hash_slots_used(&table->old_slots, table->migrate_pos)) {
+            table->migrate_pos++;
+            if (--empty_visits == 0) {
+                break;
+            }
+
+            continue;
+        }
+
+        hash_slots_place(&table->slots, slot->entry, slot->hash);
+        hash_slots_erase(&table->old_slots, table->migrate_pos);
+        table->old_size--;
+        count--;
+    }
+
+    if (table->old_size == 0) {
+        hash_slots_reset(&table->old_slots);
+        table->migrate_pos = 0;
+    }
+}
+
+/**
+ * Owned keys walker for `arena_trim()`, `pos` is the next entry to look at.
+ */
+typedef struct hash_table_keys_walk_t {
+    const hash_table_t* table;
+    size_t pos;
+} hash_table_keys_walk_t;
+
+static const void* hash_table_next_key(void* ctx)
+{
+    hash_table_keys_walk_t* walk = (hash_table_keys_walk_t*) ctx;
+    while (walk->pos < walk->table->entries_size) {
+        const hash_entry_t* entry = &walk->table->entries[walk->pos++];
+        if (entry->item.value != NULL) {
+            return entry->item.key;
+        }
+    }
+
+    return NULL;
+}
+
+/**
+ * Deallocates the arena chunks left with no live key once more than half of
+ * the arena belongs to removed entries.
+ * Live keys are never moved, entries keep the order their keys were copied
+ * in, which is what `arena_trim()` needs.
+ */
+static void hash_table_trim_keys(hash_table_t* table)
+{
+    if ((table->flags & HASH_TABLE_OWN_KEYS) && table->keys.used / 2 > table->key_bytes) {
+        hash_table_keys_walk_t walk = {table, 0};
+        arena_trim(&table->keys, hash_table_next_key, &walk);
+    }
+}
+
+/**
+ * Moves the live entries to the front of the array, keeping their order,
+ * and trims the owned keys.
+ * Every index slot is invalidated.
+ */
+static void hash_table_compact(hash_table_t* table)
+{
+    size_t size = 0;
+    for (size_t i = 0; i < table->entries_size; i++) {
+        if (table->entries[i].item.value != NULL) {
+            table->entries[size++] = table->entries[i];
+        }
+    }
+
+    table->entries_size = size;
+    table->compacting = 0;
+    hash_table_trim_keys(table);
+}
+
+/**
+ * Returns a timestamp in nanoseconds, only meant for measuring durations.
+ */
+static uint64_t hash_table_clock(void)
+{
+    struct timespec now;
+    if (timespec_get(&now, TIME_UTC) == 0) {
+        return 0;
+    }
+
+    return (uint64_t) now.tv_sec * 1000000000 + (uint64_t) now.tv_nsec;
+}
+
+static void hash_table_clock_add(hash_table_t* table, uint64_t start)
+{
+    uint64_t end = hash_table_clock();
+    if (end > start) {
+        table->rehash_time += end - start;
+    }
+}
+
+/**
+ * Migrates a single step of an incremental rehash, timing it.
+ */
+static void hash_table_migrate_step(hash_table_t* table)
+{
+    uint64_t start = hash_table_clock();
+    hash_table_migrate(table, MIGRATE_STEP);
+    hash_table_clock_add(table, start);
+}
+
+/**
+ * Ends an incremental compaction once every entry after the write cursor is
+ * a removed one, dropping them, trimming the owned keys and capping the
+ * entries array to what the index can hold if a shrink was waiting for it.
+ */
+static void hash_table_compact_done(hash_table_t* table)
+{
+    if (table->compact_write < table->entries_size) {
+        table->entries_size = table->compact_write;
+    }
+
+    while (table->entries_size > 0 && table->entries[table->entries_size - 1].item.value == NULL) {
+        table->entries_size--;
+    }
+
+    table->compacting = 0;
+    hash_table_trim_keys(table);
+    size_t capacity = hash_table_max_size(table->slots.capacity);
+    if (capacity < table->entries_capacity && table->entries_size <= capacity) {
+        hash_table_realloc_entries(table, capacity);
+    }
+}
+
+/**
+ * Moves up to `count` live entries from the read cursor down to the write
+ * cursor, visiting a bounded number of removed entries on the way.
+ * The index slot of a moved entry is found through its cached hash and
+ * pointed at the new position, so lookups keep working and the order of the
+ * entries is kept.
+ */
+static void hash_table_compact_some(hash_table_t* table, size_t count)
+{
+    size_t empty_visits = count * MIGRATE_EMPTY_VISITS;
+    while (count > 0 && table->compact_read < table->entries_size) {
+        hash_entry_t* entry = &table->entries[table->compact_read];
+        if (entry->item.value == NULL) {
+            table->compact_read++;
+            if (--empty_visits == 0) {
+                break;
+            }
+
+            continue;
+        }
+
+        if (table->compact_read != table->compact_write) {
+            hash_slot_t* slot = hash_table_probe_entry(table, &table->slots, table->compact_read);
+            if (slot == NULL && table->old_slots.items != NULL) {
+                slot = hash_table_probe_entry(table, &table->old_slots, table->compact_read);
+            }
+
+            if (slot != NULL) {
+                slot->entry = table->compact_write + 1;
+            }
+
+            table->entries[table->compact_write] = *entry;
+            entry->item.key = NULL;
+            entry->item.value = NULL;
+            entry->item.key_size = 0;
+            entry->hash = 0;
+        }
+
+        table->compact_read++;
+        table->compact_write++;
+        count--;
+    }
+
+    if (table->compact_read >= table->entries_size) {
+        hash_table_compact_done(table);
+    }
+}
+
+/**
+ * Compacts a single step of an incremental compaction, timing it.
+ */
+static void hash_table_compact_step(hash_table_t* table)
+{
+    uint64_t start = hash_table_clock();
+    hash_table_compact_some(table, COMPACT_STEP);
+    hash_table_clock_add(table, start);
+}
+
+/**
+ * Reindexes the entries with an index of the given capacity, which must be
+ * able to hold every entry, using the cached hashes.
+ * A capacity of 0 drops the index, moving back to linear search, which
+ * requires at most `SMALL_SIZE` entries.
+ * The table is left untouched if the new arrays can't be allocated.
+ * If `incremental` is set, the current index is kept around and drained by
+ * `hash_table_migrate()` instead, otherwise the entries are compacted and
+ * indexed all at once.
+ * Either way the entries array is capped to what the new index can hold, so
+ * appends trigger the next resize before the index fills up. When removed
+ * entries keep an incremental shrink from doing so right away, they're
+ * compacted incrementally and the array is capped once that's done.
+ */
+static int hash_table_reindex(hash_table_t* table, size_t new_capacity, int incremental)
+{
+    if (new_capacity > SIZE_MAX / sizeof(hash_slot_t)) {
+        return -1;
+    }
+
+    hash_slots_t new_slots = {NULL, 0, 64, 0};
+    if (new_capacity > 0 && hash_slots_init(&new_slots, new_capacity) == -1) {
+        return -1;
+    }
+
+    size_t entries_capacity = new_capacity > 0 ? hash_table_max_size(new_capacity) : SMALL_SIZE;
+    if (entries_capacity > table->entries_capacity && hash_table_realloc_entries(table, entries_capacity) == -1) {
+        free(new_slots.items);
+        return -1;
+    }
+
+    if (incremental && table->size > 0 && table->slots.items != NULL && new_slots.items != NULL) {
+        if (table->old_slots.items != NULL) {
+            hash_table_migrate(table, SIZE_MAX);
+        }
+
+        if (entries_capacity < table->entries_capacity && table->entries_size <= entries_capacity) {
+            hash_table_realloc_entries(table, entries_capacity);
+        } else if (table->entries_size > entries_capacity && !table->compacting) {
+            table->compacting = 1;
+            table->compact_read = 0;
+            table->compact_write = 0;
+        }
+
+        table->old_slots = table->slots;
+        table->old_size = table->size;
+        table->migrate_pos = 0;
+        table->slots = new_slots;
+        return 0;
+    }
+
+    hash_table_compact(table);
+    for (size_t i = 0; i < table->entries_size && new_slots.items != NULL; i++) {
+        hash_slots_place(&new_slots, i + 1, table->entries[i].hash);
+    }
+
+    hash_slots_reset(&table->old_slots);
+    table->old_size = 0;
+    table->migrate_pos = 0;
+    free(table->slots.items);
+    table->slots = new_slots;
+    if (entries_capacity < table->entries_capacity) {
+        hash_table_realloc_entries(table, entries_capacity);
+    }
+
+    return 0;
+}
+
+/**
+ * Reindexes the entries, see `hash_table_reindex()`, keeping track of how
+ * many times and for how long it's done.
+ */
+static int hash_table_resize(hash_table_t* table, size_t new_capacity, int incremental)
+{
+    uint64_t start = hash_table_clock();
+    int error = hash_table_reindex(table, new_capacity, incremental);
+    if (error == 0) {
+        table->rehashes++;
+        hash_table_clock_add(table, start);
+    }
+
+    return error;
+}
+
+/**
+ * Grows the table by `RESIZE_FACTOR`.
+ */
+static int hash_table_rehash(hash_table_t* table)
+{
+    size_t capacity = table->slots.capacity;
+    if (capacity > SIZE_MAX / RESIZE_FACTOR) {
+        return -1;
+    }
+
+    capacity = capacity > 0 ? capacity * RESIZE_FACTOR : MIN_CAPACITY;
+    return hash_table_resize(table, capacity, table->flags & HASH_TABLE_INCREMENTAL);
+}
+
+static uint64_t hash_table_hash_bytes(const hash_table_t* table, const void* data, size_t size)
+{
+    return table->keyed ? hash_keyed(data, size, table->seed) : hash_bytes(data, size, 0);
+}
+
+/**
+ * Resolves the given key for the table's mode.
+ * Addresses use Fibonacci hashing, strings and bytes go through
+ * `hash_bytes()` and custom hashes are mixed so their top bits are usable.
+ * Returns 0 on success or -1 on error (invalid key).
+ */
+static int hash_table_key(const hash_table_t* table, const void* key, hash_key_t* out)
 {
-    if (mode != HASH_TABLE_ADDRESS && mode != HASH_TABLE_STRING) {
-        return NULL;
+    if (hash_key_resolve(table->mode, key, out) == -1) {
+        return -1;
     }
 
-    hash_table_t* table = (hash_table_t*) malloc(sizeof(hash_table_t));
-    if (table == NULL) {
-        return NULL;
+    switch (table->mode) {
+    case HASH_TABLE_ADDRESS:
+        out->hash = hash_address(key);
+        break;
+    case HASH_TABLE_CUSTOM:
+        out->hash = hash_mix(table->hash(key, table->ctx));
+        break;
+    default:
+        out->hash = hash_table_hash_bytes(table, out->data, out->size);
+        break;
     }
 
-    table->mode = mode;
-    table->items = NULL;
-    table->capacity = capacity;
-    table->size = 0;
+    return 0;
+}
 
-    if (capacity > 0) {
-        linked_list_t** items = (linked_list_t**) malloc(capacity * sizeof(linked_list_t*));
-        if (items == NULL) {
-            free(table);
-            return NULL;
-        }
+static int hash_table_equals(const hash_table_t* table, const hash_table_item_t* item, const hash_key_t* key)
+{
+    switch (table->mode) {
+    case HASH_TABLE_ADDRESS:
+        return item->key == key->data;
+    case HASH_TABLE_CUSTOM:
+        return table->equals(item->key, key->data, table->ctx);
+    default:
+        break;
+    }
+
+    return item->key_size == key->size && (key->size == 0 || !memcmp(item->key, key->data, key->size));
+}
 
-        for (size_t i = 0; i < capacity; i++) {
-            items[i] = NULL;
+/**
+ * Returns the slot in `slots` holding the given key or `NULL` if not found.
+ * The probe stops as soon as it meets a slot richer than the key would be.
+ */
+static hash_slot_t* hash_table_probe(const hash_table_t* table, const hash_slots_t* slots, const hash_key_t* key)
+{
+    size_t pos = hash_slots_home(slots, key->hash);
+    size_t distance = 0;
+    uint64_t hash = hash_slots_tag(slots, key->hash);
+    while (hash_slots_used(slots, pos) && hash_slots_distance(slots, pos) >= distance) {
+        const hash_slot_t* slot = &slots->items[pos];
+        if (slot->hash == hash && hash_table_equals(table, &table->entries[slot->entry - 1].item, key)) {
+            return &slots->items[pos];
         }
 
-        table->items = items;
+        pos = hash_slots_next(slots, pos);
+        distance++;
     }
 
-    return table;
+    return NULL;
 }
 
-int hash_table_mode(const hash_table_t* table)
+/**
+ * Returns the entry holding the given key or `NULL` if not found, looking
+ * into the old index too while an incremental rehash is in progress.
+ * Without an index, the few entries there are are scanned, their cached
+ * hashes compared before their keys.
+ */
+static hash_entry_t* hash_table_find(const hash_table_t* table, const hash_key_t* key)
 {
-    if (table == NULL) {
-        return -1;
+    if (table->slots.items == NULL) {
+        for (size_t i = 0; i < table->entries_size; i++) {
+            hash_entry_t* entry = &table->entries[i];
+            if (entry->hash == key->hash && entry->item.value != NULL && hash_table_equals(table, &entry->item, key)) {
+                return entry;
+            }
+        }
+
+        return NULL;
     }
 
-    return table->mode;
+    const hash_slot_t* slot = hash_table_probe(table, &table->slots, key);
+    if (slot == NULL && table->old_slots.items != NULL) {
+        slot = hash_table_probe(table, &table->old_slots, key);
+    }
+
+    return slot != NULL ? &table->entries[slot->entry - 1] : NULL;
 }
 
-int hash_table_is_address(const hash_table_t* table)
+/**
+ * Prefetches the home slot of the given key, so probing it later doesn't
+ * stall on a cache miss.
+ */
+static void hash_table_prefetch(const hash_table_t* table, const hash_key_t* key)
 {
-    return hash_table_mode(table) == HASH_TABLE_ADDRESS;
+    if (table->slots.capacity > 0) {
+        PREFETCH(&table->slots.items[hash_slots_home(&table->slots, key->hash)]);
+    }
 }
 
-int hash_table_is_string(const hash_table_t* table)
+static void hash_table_rehash_entries(hash_table_t* table)
 {
-    return hash_table_mode(table) == HASH_TABLE_STRING;
+    for (size_t i = 0; i < table->entries_size; i++) {
+        hash_entry_t* entry = &table->entries[i];
+        if (entry->item.value != NULL) {
+            entry->hash = hash_table_hash_bytes(table, entry->item.key, entry->item.key_size);
+        }
+    }
 }
 
 /**
- * Fowler–Noll–Vo hash.
- * Yeah, science!!1
+ * Switches the table to keyed hashing with a random seed and reindexes it.
+ * Done once a probe gets longer than any decent hash would make it, which
+ * means the keys were picked to collide.
+ * The table is left as it was if the new index can't be allocated.
  */
-static size_t hash_impl(int mode, size_t capacity, const void* key)
+static void hash_table_rekey(hash_table_t* table)
 {
-    uint64_t pos = 0xcbf29ce484222325;
-    if (mode == HASH_TABLE_ADDRESS) {
-        uintptr_t address = (uintptr_t) key;
-        for (size_t i = 0; i < sizeof(uintptr_t); i++) {
-            uint8_t byte = (address >> (sizeof(uintptr_t) - 1 - i) * 8) & 0xff;
-            pos *= 0x100000001b3;
-            pos ^= byte;
-        }
-    } else {
-        const char* str = (const char*) key;
-        while (*str != '\0') {
-            uint8_t byte = *str++;
-            pos *= 0x100000001b3;
-            pos ^= byte;
-        }
+    hash_random_seed(table->seed);
+    table->keyed = 1;
+    hash_table_rehash_entries(table);
+    if (hash_table_resize(table, table->slots.capacity, 0) == -1) {
+        table->keyed = 0;
+        hash_table_rehash_entries(table);
     }
-
-    pos %= capacity;
-    return (size_t) pos;
 }
 
-static int hash_table_rehash(hash_table_t* table)
+/**
+ * Appends an entry for a key known not to be in the table.
+ * Returns the new entry or `NULL` on error. The entry is looked up again if
+ * the table had to be rekeyed, since that compacts the entries.
+ */
+static hash_entry_t* hash_table_append(hash_table_t* table, const hash_key_t* key, const void* value)
 {
-    size_t new_capacity = table->capacity > 0 ? table->capacity * RESIZE_FACTOR : 1;
-    linked_list_t** new_items = (linked_list_t**) malloc(new_capacity * sizeof(linked_list_t*));
-    if (new_items == NULL) {
-        return -1;
+    if (table->compacting) {
+        hash_table_compact_step(table);
+    } else if ((table->flags & HASH_TABLE_INCREMENTAL) && table->slots.items != NULL
+        && table->entries_size - table->size >= table->entries_capacity / 4) {
+        table->compacting = 1;
+        table->compact_read = 0;
+        table->compact_write = 0;
     }
 
-    for (size_t i = 0; i < new_capacity; i++) {
-        new_items[i] = NULL;
-    }
-
-    for (size_t i = 0; i < table->capacity; i++) {
-        linked_list_t* list = table->items[i];
-        if (list != NULL) {
-            list_node_t* iter = list->head;
-            while (iter != NULL) {
-                list_node_t* next = iter->next;
-                const void* key = iter->item.key;
-                const void* value = iter->item.value;
-
-                size_t new_pos = hash_impl(table->mode, new_capacity, key);
-                linked_list_t* new_list = new_items[new_pos];
-                if (new_list == NULL) {
-                    new_list = (linked_list_t*) malloc(sizeof(linked_list_t));
-                    if (new_list == NULL) {
-                        for (size_t i = 0; i < new_capacity; i++) {
-                            linked_list_t* new_list = new_items[i];
-                            if (new_list != NULL) {
-                                list_node_t* new_iter = new_list->head;
-                                while (new_iter != NULL) {
-                                    list_node_t* new_next = new_iter->next;
-                                    free(new_iter);
-                                    new_iter = new_next;
-                                }
-
-                                free(new_list);
-                            }
-                        }
-
-                        free(new_items);
-                        return -1;
-                    }
-
-                    new_list->head = NULL;
-                    new_list->size = 0;
-                    new_items[new_pos] = new_list;
-                }
-
-                list_node_t* new_tail = NULL;
-                list_node_t* new_iter = new_list->head;
-                while (new_iter != NULL) {
-                    new_tail = new_iter;
-                    new_iter = new_iter->next;
-                }
-
-                list_node_t* new_node = (list_node_t*) malloc(sizeof(list_node_t));
-                if (new_node == NULL) {
-                    for (size_t i = 0; i < new_capacity; i++) {
-                        linked_list_t* new_list = new_items[i];
-                        if (new_list != NULL) {
-                            list_node_t* new_iter = new_list->head;
-                            while (new_iter != NULL) {
-                                list_node_t* new_next = new_iter->next;
-                                free(new_iter);
-                                new_iter = new_next;
-                            }
-
-                            free(new_list);
-                        }
-                    }
-
-                    free(new_items);
-                    return -1;
-                }
-
-                new_node->item.key = key;
-                new_node->item.value = value;
-                new_node->next = NULL;
-
-                if (new_tail != NULL) {
-                    new_tail->next = new_node;
-                }
-
-                if (new_list->head == NULL) {
-                    new_list->head = new_node;
-                }
-
-                new_list->size++;
-                iter = next;
-            }
+    if (table->entries_size == table->entries_capacity
+        || (table->slots.items != NULL && table->size >= hash_table_max_size(table->slots.capacity))) {
+        int error = 0;
+        if (table->size > table->entries_capacity / 2 || table->entries_capacity == 0
+            || (table->flags & HASH_TABLE_INCREMENTAL)) {
+            error = hash_table_rehash(table);
+        } else {
+            error = hash_table_resize(table, table->slots.capacity, 0);
+        }
+
+        if (error == -1) {
+            return NULL;
         }
     }
 
-    for (size_t i = 0; i < table->capacity; i++) {
-        linked_list_t* list = table->items[i];
-        if (list != NULL) {
-            list_node_t* iter = list->head;
-            while (iter != NULL) {
-                list_node_t* next = iter->next;
-                free(iter);
-                iter = next;
-            }
+    const void* data = key->data;
+    if (table->flags & HASH_TABLE_OWN_KEYS) {
+        char* copy = (char*) arena_alloc(&table->keys, key->size + 1);
+        if (copy == NULL) {
+            return NULL;
+        }
 
-            free(list);
+        if (key->size > 0) {
+            memcpy(copy, key->data, key->size);
         }
+
+        copy[key->size] = '\0';
+        table->key_bytes += key->size + 1;
+        data = copy;
     }
 
-    free(table->items);
-    table->items = new_items;
-    table->capacity = new_capacity;
-    return 0;
+    hash_entry_t* entry = &table->entries[table->entries_size++];
+    entry->item.key = data;
+    entry->item.value = value;
+    entry->item.key_size = key->size;
+    entry->hash = key->hash;
+
+    size_t distance = table->slots.items != NULL ? hash_slots_place(&table->slots, table->entries_size, key->hash) : 0;
+    table->size++;
+    if (distance > MAX_PROBE_DISTANCE && !table->keyed && (table->mode == HASH_TABLE_STRING || table->mode == HASH_TABLE_BYTES)) {
+        hash_table_rekey(table);
+        hash_key_t rekeyed = *key;
+        rekeyed.hash = hash_table_hash_bytes(table, key->data, key->size);
+        entry = hash_table_find(table, &rekeyed);
+    }
+
+    return entry;
 }
 
-static size_t hash_table_hash(const hash_table_t* table, const void* key)
+/**
+ * Returns the entry holding the given key, appending one with `value` if
+ * there's none, or `NULL` on error.
+ * `inserted` is set to 1 if the entry was appended, 0 otherwise.
+ */
+static hash_entry_t* hash_table_upsert(hash_table_t* table, const hash_key_t* key, const void* value, int* inserted)
 {
-    return hash_impl(table->mode, table->capacity, key);
+    if (table->old_slots.items != NULL) {
+        hash_table_migrate_step(table);
+    }
+
+    *inserted = 0;
+    if (table->size > 0) {
+        hash_entry_t* entry = hash_table_find(table, key);
+        if (entry != NULL) {
+            return entry;
+        }
+    }
+
+    hash_entry_t* entry = hash_table_append(table, key, value);
+    *inserted = entry != NULL;
+    return entry;
 }
 
-static int hash_table_equals(const hash_table_t* table, const void* key, const void* target)
+static int hash_table_push_key(hash_table_t* table, const hash_key_t* key, const void* value)
 {
-    if (table->mode == HASH_TABLE_ADDRESS) {
-        return key == target;
+    int inserted = 0;
+    hash_entry_t* entry = hash_table_upsert(table, key, value, &inserted);
+    if (entry == NULL) {
+        return -1;
     }
 
-    return !strcmp((const char*) key, (const char*) target);
+    entry->item.value = value;
+    return 0;
 }
 
 int hash_table_push(hash_table_t* table, const void* key, const void* value)
 {
-    if (table == NULL || (hash_table_is_string(table) && key == NULL) || value == NULL) {
+    hash_key_t resolved;
+    if (table == NULL || value == NULL || hash_table_key(table, key, &resolved) == -1) {
         return -1;
     }
 
-    if (!hash_table_capacity(table) || !(hash_table_load_factor(table) < MAX_LOAD_FACTOR)) {
-        int error = hash_table_rehash(table);
-        if (error == -1) {
-            return -1;
-        }
-    }
-
-    size_t pos = hash_table_hash(table, key);
-    linked_list_t* list = table->items[pos];
-    if (list == NULL) {
-        list = (linked_list_t*) malloc(sizeof(linked_list_t));
-        if (list == NULL) {
-            return -1;
-        }
+    return hash_table_push_key(table, &resolved, value);
+}
 
-        list->head = NULL;
-        list->size = 0;
-        table->items[pos] = list;
+int hash_table_push_many(hash_table_t* table, const void* const* keys, const void* const* values, size_t count)
+{
+    if (table == NULL || (count > 0 && (keys == NULL || values == NULL))) {
+        return -1;
     }
 
-    list_node_t* tail = NULL;
-    list_node_t* iter = list->head;
-    while (iter != NULL) {
-        if (hash_table_equals(table, iter->item.key, key)) {
-            iter->item.value = value;
-            return 0;
+    int error = 0;
+    hash_key_t resolved[BATCH_SIZE];
+    for (size_t i = 0; i < count && error == 0; i += BATCH_SIZE) {
+        int keyed = table->keyed;
+        size_t batch = count - i < BATCH_SIZE ? count - i : BATCH_SIZE;
+        for (size_t j = 0; j < batch; j++) {
+            if (values[i + j] == NULL || hash_table_key(table, keys[i + j], &resolved[j]) == -1) {
+                batch = j;
+                error = -1;
+                break;
+            }
+
+            hash_table_prefetch(table, &resolved[j]);
         }
 
-        tail = iter;
-        iter = iter->next;
-    }
+        for (size_t j = 0; j < batch; j++) {
+            if (table->keyed != keyed) {
+                hash_table_key(table, keys[i + j], &resolved[j]);
+            }
 
-    list_node_t* node = (list_node_t*) malloc(sizeof(list_node_t));
-    if (node == NULL) {
-        return -1;
+            if (hash_table_push_key(table, &resolved[j], values[i + j]) == -1) {
+                return -1;
+            }
+        }
     }
 
-    node->item.key = key;
-    node->item.value = value;
-    node->next = NULL;
+    return error;
+}
 
-    if (tail != NULL) {
-        tail->next = node;
+const void** hash_table_get_or_insert(hash_table_t* table, const void* key, const void* value, int* inserted)
+{
+    int appended = 0;
+    hash_key_t resolved;
+    if (table == NULL || value == NULL || hash_table_key(table, key, &resolved) == -1) {
+        return NULL;
     }
 
-    if (list->head == NULL) {
-        list->head = node;
+    hash_entry_t* entry = hash_table_upsert(table, &resolved, value, &appended);
+    if (inserted != NULL) {
+        *inserted = appended;
     }
 
-    list->size++;
-    table->size++;
-    return 0;
+    return entry != NULL ? &entry->item.value : NULL;
 }
 
 const void* hash_table_at(const hash_table_t* table, const void* key)
 {
-    if (!hash_table_capacity(table) || (hash_table_is_string(table) && key == NULL)) {
+    hash_key_t resolved;
+    if (hash_table_is_empty(table) || hash_table_key(table, key, &resolved) == -1) {
         return NULL;
     }
 
-    size_t pos = hash_table_hash(table, key);
-    linked_list_t* list = table->items[pos];
-    if (list != NULL) {
-        list_node_t* iter = list->head;
-        while (iter != NULL) {
-            if (hash_table_equals(table, iter->item.key, key)) {
-                return iter->item.value;
+    const hash_entry_t* entry = hash_table_find(table, &resolved);
+    return entry != NULL ? entry->item.value : NULL;
+}
+
+size_t hash_table_at_many(const hash_table_t* table, const void* const* keys, size_t count, const void** values)
+{
+    if (table == NULL || keys == NULL || values == NULL) {
+        return 0;
+    }
+
+    size_t found = 0;
+    hash_key_t resolved[BATCH_SIZE];
+    int valid[BATCH_SIZE];
+    for (size_t i = 0; i < count; i += BATCH_SIZE) {
+        size_t batch = count - i < BATCH_SIZE ? count - i : BATCH_SIZE;
+        for (size_t j = 0; j < batch; j++) {
+            valid[j] = table->size > 0 && hash_table_key(table, keys[i + j], &resolved[j]) == 0;
+            if (valid[j]) {
+                hash_table_prefetch(table, &resolved[j]);
             }
-            iter = iter->next;
+        }
+
+        for (size_t j = 0; j < batch; j++) {
+            const hash_entry_t* entry = valid[j] ? hash_table_find(table, &resolved[j]) : NULL;
+            values[i + j] = entry != NULL ? entry->item.value : NULL;
+            found += entry != NULL;
         }
     }
 
-    return NULL;
+    return found;
 }
 
 int hash_table_is_empty(const hash_table_t* table)
@@ -324,6 +1098,29 @@ int hash_table_contains(const hash_table_t* table, const void* key)
     return hash_table_at(table, key) != NULL;
 }
 
+/**
+ * Returns an iterator pointing to the first live entry at or after the given
+ * position or a `NULL`ed/zero struct if there's none.
+ */
+static hash_table_iterator_t hash_table_seek(const hash_table_t* table, size_t pos)
+{
+    hash_table_iterator_t iter;
+    iter.table = NULL;
+    iter.pos = 0;
+    iter.node = NULL;
+
+    for (; pos < table->entries_size; pos++) {
+        if (table->entries[pos].item.value != NULL) {
+            iter.table = table;
+            iter.pos = pos;
+            iter.node = &table->entries[pos];
+            break;
+        }
+    }
+
+    return iter;
+}
+
 hash_table_iterator_t hash_table_begin(const hash_table_t* table)
 {
     hash_table_iterator_t iter;
@@ -332,15 +1129,7 @@ hash_table_iterator_t hash_table_begin(const hash_table_t* table)
     iter.node = NULL;
 
     if (hash_table_size(table) > 0) {
-        iter.table = table;
-        for (size_t i = 0; i < table->capacity; i++) {
-            linked_list_t* list = table->items[i];
-            if (list != NULL && list->head != NULL) {
-                iter.pos = i;
-                iter.node = list->head;
-                break;
-            }
-        }
+        iter = hash_table_seek(table, 0);
     }
 
     return iter;
@@ -359,25 +1148,7 @@ hash_table_iterator_t hash_table_next(hash_table_iterator_t iter)
     next.node = NULL;
 
     if (iter.table != NULL) {
-        const list_node_t* node = (const list_node_t*) iter.node;
-        if (node != NULL) {
-            if (node->next != NULL) {
-                next.table = iter.table;
-                next.pos = iter.pos;
-                next.node = node->next;
-                return next;
-            }
-        }
-
-        for (size_t i = iter.pos + 1; i < iter.table->capacity; i++) {
-            linked_list_t* list = iter.table->items[i];
-            if (list != NULL && list->head != NULL) {
-                next.table = iter.table;
-                next.pos = i;
-                next.node = list->head;
-                return next;
-            }
-        }
+        next = hash_table_seek(iter.table, iter.pos + 1);
     }
 
     return next;
@@ -386,65 +1157,247 @@ hash_table_iterator_t hash_table_next(hash_table_iterator_t iter)
 hash_table_item_t hash_table_item(hash_table_iterator_t iter)
 {
     hash_table_item_t item;
-    item.key = iter.node != NULL ? ((const list_node_t*) iter.node)->item.key : NULL;
-    item.value = iter.node != NULL ? ((const list_node_t*) iter.node)->item.value : NULL;
+    item.key = iter.node != NULL ? ((const hash_entry_t*) iter.node)->item.key : NULL;
+    item.value = iter.node != NULL ? ((const hash_entry_t*) iter.node)->item.value : NULL;
+    item.key_size = iter.node != NULL ? ((const hash_entry_t*) iter.node)->item.key_size : 0;
     return item;
 }
 
-void hash_table_remove(hash_table_t* table, const void* key)
+/**
+ * Marks the entry at the given position as removed.
+ * Removed entries at the end of the array are dropped right away, the rest
+ * wait for the next compaction so the order of the others is kept.
+ */
+static void hash_table_erase_entry(hash_table_t* table, size_t pos)
+{
+    if (table->flags & HASH_TABLE_OWN_KEYS) {
+        table->key_bytes -= table->entries[pos].item.key_size + 1;
+    }
+
+    table->entries[pos].item.key = NULL;
+    table->entries[pos].item.value = NULL;
+    table->entries[pos].item.key_size = 0;
+    table->entries[pos].hash = 0;
+
+    while (table->entries_size > 0 && table->entries[table->entries_size - 1].item.value == NULL) {
+        table->entries_size--;
+    }
+
+    if (table->compacting && table->entries_size <= table->compact_read) {
+        hash_table_compact_done(table);
+    }
+}
+
+/**
+ * Removes the given index slot of `slots` and the entry it refers to.
+ */
+static void hash_table_erase_slot(hash_table_t* table, hash_slots_t* slots, hash_slot_t* slot)
+{
+    size_t entry = slot->entry - 1;
+    hash_slots_erase(slots, (size_t) (slot - slots->items));
+    hash_table_erase_entry(table, entry);
+    if (slots == &table->old_slots) {
+        table->old_size--;
+    }
+
+    table->size--;
+}
+
+/**
+ * Moves an incremental rehash forward after removals or, in
+ * `HASH_TABLE_AUTO_SHRINK` mode, moves an incremental compaction forward and
+ * shrinks the table if it got too sparse.
+ */
+static void hash_table_removed(hash_table_t* table)
 {
-    if (!hash_table_capacity(table) || (hash_table_is_string(table) && key == NULL)) {
+    if (table->compacting && (table->flags & HASH_TABLE_AUTO_SHRINK)) {
+        hash_table_compact_step(table);
+    }
+
+    if (table->old_slots.items != NULL) {
+        hash_table_migrate_step(table);
+    } else if ((table->flags & HASH_TABLE_AUTO_SHRINK) && table->slots.items != NULL
+        && hash_table_load_factor(table) < MIN_LOAD_FACTOR) {
+        size_t capacity = table->size > SMALL_SIZE ? hash_fit_capacity(table->size, MAX_LOAD_FACTOR, MIN_CAPACITY) : 0;
+        if (capacity < table->slots.capacity) {
+            hash_table_resize(table, capacity, table->flags & HASH_TABLE_INCREMENTAL);
+        }
+    }
+}
+
+static void hash_table_remove_key(hash_table_t* table, const hash_key_t* key)
+{
+    if (table->slots.items == NULL) {
+        hash_entry_t* entry = hash_table_find(table, key);
+        if (entry != NULL) {
+            hash_table_erase_entry(table, (size_t) (entry - table->entries));
+            table->size--;
+        }
+
         return;
     }
 
-    size_t pos = hash_table_hash(table, key);
-    linked_list_t* list = table->items[pos];
-    if (list == NULL) {
+    hash_slots_t* slots = &table->slots;
+    hash_slot_t* slot = hash_table_probe(table, slots, key);
+    if (slot == NULL && table->old_slots.items != NULL) {
+        slots = &table->old_slots;
+        slot = hash_table_probe(table, slots, key);
+    }
+
+    if (slot != NULL) {
+        hash_table_erase_slot(table, slots, slot);
+    }
+
+    hash_table_removed(table);
+}
+
+/**
+ * Removes the live entry at the given position, without shrinking the table
+ * so the positions of the other entries are kept.
+ */
+static void hash_table_erase_at(hash_table_t* table, size_t pos)
+{
+    if (table->slots.items == NULL) {
+        hash_table_erase_entry(table, pos);
+        table->size--;
         return;
     }
 
-    list_node_t* prev = NULL;
-    list_node_t* iter = list->head;
-    while (iter != NULL) {
-        list_node_t* next = iter->next;
-        if (hash_table_equals(table, iter->item.key, key)) {
-            if (prev != NULL) {
-                prev->next = next;
-            }
+    hash_slots_t* slots = &table->slots;
+    hash_slot_t* slot = hash_table_probe_entry(table, slots, pos);
+    if (slot == NULL && table->old_slots.items != NULL) {
+        slots = &table->old_slots;
+        slot = hash_table_probe_entry(table, slots, pos);
+    }
 
-            if (iter == list->head) {
-                list->head = next;
-            }
+    if (slot != NULL) {
+        hash_table_erase_slot(table, slots, slot);
+    }
+}
 
-            free(iter);
-            list->size--;
-            table->size--;
-            break;
+void hash_table_remove(hash_table_t* table, const void* key)
+{
+    hash_key_t resolved;
+    if (!hash_table_is_empty(table) && hash_table_key(table, key, &resolved) == 0) {
+        hash_table_remove_key(table, &resolved);
+    }
+}
+
+int hash_table_update_with(hash_table_t* table, const void* key, hash_table_update_t update, void* ctx)
+{
+    hash_key_t resolved;
+    if (table == NULL || update == NULL || hash_table_key(table, key, &resolved) == -1) {
+        return -1;
+    }
+
+    if (table->old_slots.items != NULL) {
+        hash_table_migrate_step(table);
+    }
+
+    hash_entry_t* entry = table->size > 0 ? hash_table_find(table, &resolved) : NULL;
+    const void* value = update(key, entry != NULL ? entry->item.value : NULL, ctx);
+    if (entry != NULL && value != NULL) {
+        entry->item.value = value;
+    } else if (entry != NULL) {
+        hash_table_erase_at(table, (size_t) (entry - table->entries));
+        hash_table_removed(table);
+    } else if (value != NULL && hash_table_append(table, &resolved, value) == NULL) {
+        return -1;
+    }
+
+    return 0;
+}
+
+hash_table_iterator_t hash_table_erase(hash_table_t* table, hash_table_iterator_t iter)
+{
+    hash_table_iterator_t next;
+    next.table = NULL;
+    next.pos = 0;
+    next.node = NULL;
+
+    if (table == NULL || iter.table != table || iter.pos >= table->entries_size
+        || table->entries[iter.pos].item.value == NULL) {
+        return next;
+    }
+
+    hash_table_erase_at(table, iter.pos);
+    if (table->old_slots.items != NULL) {
+        hash_table_migrate_step(table);
+    }
+
+    return hash_table_seek(table, iter.pos + 1);
+}
+
+size_t hash_table_retain(hash_table_t* table, hash_table_predicate_t predicate, void* ctx)
+{
+    if (table == NULL || predicate == NULL) {
+        return 0;
+    }
+
+    size_t removed = 0;
+    for (size_t i = 0; i < table->entries_size; i++) {
+        const hash_table_item_t* item = &table->entries[i].item;
+        if (item->value != NULL && !predicate(item->key, item->value, ctx)) {
+            hash_table_erase_at(table, i);
+            removed++;
         }
+    }
+
+    if (removed > 0) {
+        hash_table_removed(table);
+    }
+
+    return removed;
+}
+
+int hash_table_reserve(hash_table_t* table, size_t size)
+{
+    if (table == NULL) {
+        return -1;
+    }
+
+    if (size <= SMALL_SIZE && table->slots.items == NULL) {
+        return 0;
+    }
+
+    size_t capacity = hash_fit_capacity(size, MAX_LOAD_FACTOR, MIN_CAPACITY);
+    if (capacity == 0) {
+        return -1;
+    }
+
+    if (capacity <= table->slots.capacity) {
+        return 0;
+    }
+
+    return hash_table_resize(table, capacity, table->flags & HASH_TABLE_INCREMENTAL);
+}
+
+int hash_table_shrink_to_fit(hash_table_t* table)
+{
+    if (table == NULL) {
+        return -1;
+    }
 
-        prev = iter;
-        iter = next;
+    size_t capacity = table->size > SMALL_SIZE ? hash_fit_capacity(table->size, MAX_LOAD_FACTOR, MIN_CAPACITY) : 0;
+    if (capacity >= table->slots.capacity && table->entries_size == table->size && table->old_slots.items == NULL) {
+        return 0;
     }
+
+    return hash_table_resize(table, capacity < table->slots.capacity ? capacity : table->slots.capacity, 0);
 }
 
 void hash_table_clear(hash_table_t* table)
 {
     if (table != NULL) {
-        for (size_t i = 0; i < table->capacity; i++) {
-            linked_list_t* list = table->items[i];
-            if (list != NULL) {
-                list_node_t* iter = list->head;
-                while (iter != NULL) {
-                    list_node_t* next = iter->next;
-                    free(iter);
-                    iter = next;
-                }
-
-                list->head = NULL;
-                list->size = 0;
-            }
-        }
-
+        hash_slots_clear(&table->slots);
+        table->entries_size = 0;
+        arena_reset(&table->keys);
+        table->key_bytes = 0;
+
+        hash_slots_reset(&table->old_slots);
+        table->old_size = 0;
+        table->migrate_pos = 0;
+        table->compacting = 0;
         table->size = 0;
     }
 }
@@ -456,32 +1409,69 @@ size_t hash_table_size(const hash_table_t* table)
 
 size_t hash_table_capacity(const hash_table_t* table)
 {
-    return table != NULL ? table->capacity : 0;
+    if (table == NULL) {
+        return 0;
+    }
+
+    return table->slots.items != NULL ? table->slots.capacity : SMALL_SIZE;
 }
 
 float hash_table_load_factor(const hash_table_t* table)
 {
-    return hash_table_capacity(table) > 0 ? (float) table->size / (float) table->capacity : 0;
+    return hash_table_capacity(table) > 0 ? (float) table->size / (float) hash_table_capacity(table) : 0;
+}
+
+int hash_table_stats(const hash_table_t* table, hash_table_stats_t* stats)
+{
+    if (table == NULL || stats == NULL) {
+        return -1;
+    }
+
+    memset(stats, 0, sizeof(hash_table_stats_t));
+    stats->size = table->size;
+    stats->capacity = hash_table_capacity(table);
+    stats->removed = table->entries_size - table->size;
+
+    size_t total_probe = 0;
+    const hash_slots_t* indexes[] = {&table->slots, &table->old_slots};
+    for (size_t i = 0; i < sizeof(indexes) / sizeof(indexes[0]); i++) {
+        const hash_slots_t* slots = indexes[i];
+        for (size_t pos = 0; pos < slots->capacity; pos++) {
+            if (!hash_slots_used(slots, pos)) {
+                continue;
+            }
+
+            size_t distance = hash_slots_distance(slots, pos);
+            stats->probes[distance < HASH_TABLE_STATS_PROBES ? distance : HASH_TABLE_STATS_PROBES - 1]++;
+            stats->max_probe = distance > stats->max_probe ? distance : stats->max_probe;
+            total_probe += distance;
+        }
+    }
+
+    stats->mean_probe = table->size > 0 ? (double) total_probe / (double) table->size : 0;
+    stats->rehashes = table->rehashes;
+    stats->rehash_time = (double) table->rehash_time / 1e9;
+    stats->index_bytes = (table->slots.capacity + table->old_slots.capacity) * sizeof(hash_slot_t);
+    stats->entry_bytes = table->entries_capacity * sizeof(hash_entry_t);
+    stats->key_bytes = arena_bytes(&table->keys);
+    stats->total_bytes = sizeof(hash_table_t) + stats->index_bytes + stats->key_bytes;
+    if (table->entries != table->small) {
+        stats->total_bytes += stats->entry_bytes;
+    }
+
+    return 0;
 }
 
 void hash_table_release(hash_table_t* table)
 {
     if (table != NULL) {
-        for (size_t i = 0; i < table->capacity; i++) {
-            linked_list_t* list = table->items[i];
-            if (list != NULL) {
-                list_node_t* iter = list->head;
-                while (iter != NULL) {
-                    list_node_t* next = iter->next;
-                    free(iter);
-                    iter = next;
-                }
-
-                free(list);
-            }
+        free(table->old_slots.items);
+        free(table->slots.items);
+        if (table->entries != table->small) {
+            free(table->entries);
         }
 
-        free(table->items);
+        arena_release(&table->keys);
         free(table);
     }
 }
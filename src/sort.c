@@ -0,0 +1,1232 @@
+#if !defined(_WIN32)
+#define _POSIX_C_SOURCE 200809L
+#endif
+
+#include "sort.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if !defined(_WIN32)
+#include <pthread.h>
+#include <unistd.h>
+#endif
+
+#define INSERTION_SORT_THRESHOLD 24
+#define NINTHER_THRESHOLD 128
+#define PARTIAL_INSERTION_SORT_LIMIT 8
+#define BLOCK_SIZE 64
+#define MIN_MERGE 64
+#define MIN_GALLOP 7
+#define MAX_RUNS 85
+#define RADIX_BITS 8
+#define RADIX_SIZE 256
+#define RADIX_PASSES 8
+#define RADIX_THRESHOLD 64
+#define PARALLEL_MIN_RUN 32768
+#define MAX_THREADS 256
+
+static void sort_swap(const void** one, const void** other)
+{
+    const void* value = *one;
+    *one = *other;
+    *other = value;
+}
+
+/**
+ * Compare function of a sort, taking a context or not.
+ * The pdqsort functions take it rather than a `compare_t` so that both kinds
+ * are called directly, at the cost of a branch that always goes the same
+ * way during a sort.
+ */
+typedef struct sort_compare_t {
+    compare_t compare;
+    compare_ctx_t compare_ctx;
+    void* ctx;
+} sort_compare_t;
+
+static int sort_compare(const sort_compare_t* compare, const void* one, const void* other)
+{
+    if (compare->compare != NULL) {
+        return compare->compare(one, other);
+    }
+
+    return compare->compare_ctx(one, other, compare->ctx);
+}
+
+/**
+ * Sorts two values.
+ */
+static void sort_2(const void** one, const void** other, const sort_compare_t* compare)
+{
+    if (sort_compare(compare, *other, *one) < 0) {
+        sort_swap(one, other);
+    }
+}
+
+/**
+ * Sorts three values, `two` ending up as their median.
+ */
+static void sort_3(const void** one, const void** two, const void** three, const sort_compare_t* compare)
+{
+    sort_2(one, two, compare);
+    sort_2(two, three, compare);
+    sort_2(one, two, compare);
+}
+
+static void sort_insertion(const void** begin, const void** end, const sort_compare_t* compare)
+{
+    for (const void** cur = begin + 1; cur < end; cur++) {
+        const void** sift = cur;
+        if (sort_compare(compare, *sift, *(sift - 1)) < 0) {
+            const void* value = *sift;
+            do {
+                *sift = *(sift - 1);
+                sift--;
+            } while (sift != begin && sort_compare(compare, value, *(sift - 1)) < 0);
+
+            *sift = value;
+        }
+    }
+}
+
+/**
+ * Insertion sort for ranges preceded by a value no greater than any of
+ * theirs, which stops the sifts without bounds checks.
+ */
+static void sort_insertion_unguarded(const void** begin, const void** end, const sort_compare_t* compare)
+{
+    for (const void** cur = begin + 1; cur < end; cur++) {
+        const void** sift = cur;
+        if (sort_compare(compare, *sift, *(sift - 1)) < 0) {
+            const void* value = *sift;
+            do {
+                *sift = *(sift - 1);
+                sift--;
+            } while (sort_compare(compare, value, *(sift - 1)) < 0);
+
+            *sift = value;
+        }
+    }
+}
+
+/**
+ * Insertion sort giving up once more than `PARTIAL_INSERTION_SORT_LIMIT`
+ * values had to be moved.
+ * Returns 1 if the range got sorted, 0 otherwise.
+ */
+static int sort_insertion_partial(const void** begin, const void** end, const sort_compare_t* compare)
+{
+    size_t moves = 0;
+    for (const void** cur = begin + 1; cur < end; cur++) {
+        const void** sift = cur;
+        if (sort_compare(compare, *sift, *(sift - 1)) < 0) {
+            const void* value = *sift;
+            do {
+                *sift = *(sift - 1);
+                sift--;
+            } while (sift != begin && sort_compare(compare, value, *(sift - 1)) < 0);
+
+            *sift = value;
+            moves += (size_t) (cur - sift);
+        }
+
+        if (moves > PARTIAL_INSERTION_SORT_LIMIT) {
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+static void sort_sift_down(const void** values, size_t pos, size_t size, const sort_compare_t* compare)
+{
+    const void* value = values[pos];
+    size_t child = 2 * pos + 1;
+    while (child < size) {
+        if (child + 1 < size && sort_compare(compare, values[child], values[child + 1]) < 0) {
+            child++;
+        }
+
+        if (sort_compare(compare, value, values[child]) >= 0) {
+            break;
+        }
+
+        values[pos] = values[child];
+        pos = child;
+        child = 2 * pos + 1;
+    }
+
+    values[pos] = value;
+}
+
+static void sort_heapsort(const void** begin, const void** end, const sort_compare_t* compare)
+{
+    size_t size = (size_t) (end - begin);
+    for (size_t i = size / 2; i > 0; i--) {
+        sort_sift_down(begin, i - 1, size, compare);
+    }
+
+    for (size_t i = size; i > 1; i--) {
+        sort_swap(begin, begin + i - 1);
+        sort_sift_down(begin, 0, i - 1, compare);
+    }
+}
+
+/**
+ * Swaps `count` pairs of misplaced values, found at `first + offsets_l[i]`
+ * and `last - offsets_r[i]`.
+ * Unless there are as many on both sides, the values are moved around in a
+ * cycle instead, which takes one move per value rather than three.
+ */
+static void sort_swap_offsets(const void** first, const void** last, const unsigned char* offsets_l,
+    const unsigned char* offsets_r, size_t count, int use_swaps)
+{
+    if (use_swaps) {
+        for (size_t i = 0; i < count; i++) {
+            sort_swap(first + offsets_l[i], last - offsets_r[i]);
+        }
+    } else if (count > 0) {
+        const void** l = first + offsets_l[0];
+        const void** r = last - offsets_r[0];
+        const void* value = *l;
+        *l = *r;
+        for (size_t i = 1; i < count; i++) {
+            l = first + offsets_l[i];
+            *r = *l;
+            r = last - offsets_r[i];
+            *l = *r;
+        }
+
+        *r = value;
+    }
+}
+
+/**
+ * Partitions the range around its first value, values equal to the pivot
+ * going to the right.
+ * Misplaced values are found a block at a time and their offsets recorded
+ * without branching on the comparisons, then swapped, so mispredictions
+ * don't grow with the number of values.
+ * Returns the final position of the pivot, `already_partitioned` is set if
+ * no value had to be swapped.
+ */
+static const void** sort_partition_right(const void** begin, const void** end, const sort_compare_t* compare, int* already_partitioned)
+{
+    const void* pivot = *begin;
+    const void** first = begin;
+    const void** last = end;
+
+    while (sort_compare(compare, *++first, pivot) < 0) {
+    }
+
+    if (first - 1 == begin) {
+        while (first < last && sort_compare(compare, *--last, pivot) >= 0) {
+        }
+    } else {
+        while (sort_compare(compare, *--last, pivot) >= 0) {
+        }
+    }
+
+    *already_partitioned = first >= last;
+    if (!*already_partitioned) {
+        sort_swap(first, last);
+        first++;
+
+        unsigned char offsets_l[BLOCK_SIZE];
+        unsigned char offsets_r[BLOCK_SIZE];
+        const void** offsets_l_base = first;
+        const void** offsets_r_base = last;
+        size_t num_l = 0;
+        size_t num_r = 0;
+        size_t start_l = 0;
+        size_t start_r = 0;
+
+        while (first < last) {
+            size_t unknown = (size_t) (last - first);
+            size_t left_split = num_l == 0 ? (num_r == 0 ? unknown / 2 : unknown) : 0;
+            size_t right_split = num_r == 0 ? unknown - left_split : 0;
+
+            size_t block = left_split < BLOCK_SIZE ? left_split : BLOCK_SIZE;
+            for (size_t i = 0; i < block; i++) {
+                offsets_l[num_l] = (unsigned char) i;
+                num_l += sort_compare(compare, *first, pivot) >= 0;
+                first++;
+            }
+
+            block = right_split < BLOCK_SIZE ? right_split : BLOCK_SIZE;
+            for (size_t i = 0; i < block; i++) {
+                offsets_r[num_r] = (unsigned char) (i + 1);
+                num_r += sort_compare(compare, *--last, pivot) < 0;
+            }
+
+            size_t count = num_l < num_r ? num_l : num_r;
+            sort_swap_offsets(offsets_l_base, offsets_r_base, offsets_l + start_l, offsets_r + start_r, count, num_l == num_r);
+            num_l -= count;
+            num_r -= count;
+            start_l += count;
+            start_r += count;
+
+            if (num_l == 0) {
+                start_l = 0;
+                offsets_l_base = first;
+            }
+
+            if (num_r == 0) {
+                start_r = 0;
+                offsets_r_base = last;
+            }
+        }
+
+        if (num_l > 0) {
+            while (num_l-- > 0) {
+                sort_swap(offsets_l_base + offsets_l[start_l + num_l], --last);
+            }
+
+            first = last;
+        }
+
+        if (num_r > 0) {
+            while (num_r-- > 0) {
+                sort_swap(offsets_r_base - offsets_r[start_r + num_r], first);
+                first++;
+            }
+
+            last = first;
+        }
+    }
+
+    const void** pivot_pos = first - 1;
+    *begin = *pivot_pos;
+    *pivot_pos = pivot;
+    return pivot_pos;
+}
+
+/**
+ * Partitions the range around its first value, values equal to the pivot
+ * going to the left.
+ * Only used when the pivot equals the value right before the range, in
+ * which case everything on the left ends up equal and is left alone.
+ * Returns the final position of the pivot.
+ */
+static const void** sort_partition_left(const void** begin, const void** end, const sort_compare_t* compare)
+{
+    const void* pivot = *begin;
+    const void** first = begin;
+    const void** last = end;
+
+    while (sort_compare(compare, pivot, *--last) < 0) {
+    }
+
+    if (last + 1 == end) {
+        while (first < last && sort_compare(compare, pivot, *++first) >= 0) {
+        }
+    } else {
+        while (sort_compare(compare, pivot, *++first) >= 0) {
+        }
+    }
+
+    while (first < last) {
+        sort_swap(first, last);
+        while (sort_compare(compare, pivot, *--last) < 0) {
+        }
+
+        while (sort_compare(compare, pivot, *++first) >= 0) {
+        }
+    }
+
+    *begin = *last;
+    *last = pivot;
+    return last;
+}
+
+/**
+ * Moves a few values of a range that partitioned badly around, breaking
+ * the pattern that caused it.
+ */
+static void sort_shuffle(const void** begin, const void** end, size_t size)
+{
+    if (size >= INSERTION_SORT_THRESHOLD) {
+        sort_swap(begin, begin + size / 4);
+        sort_swap(end - 1, end - size / 4);
+        if (size > NINTHER_THRESHOLD) {
+            sort_swap(begin + 1, begin + (size / 4 + 1));
+            sort_swap(begin + 2, begin + (size / 4 + 2));
+            sort_swap(end - 2, end - (size / 4 + 1));
+            sort_swap(end - 3, end - (size / 4 + 2));
+        }
+    }
+}
+
+/**
+ * Sorts the range, recursing into the smaller partition and looping over the
+ * larger one, so the stack depth stays logarithmic.
+ * `bad_allowed` is the number of unbalanced partitions tolerated before
+ * falling back to heapsort, `leftmost` is 0 if the range is preceded by a
+ * value no greater than any of its own.
+ */
+static void sort_pdq(const void** begin, const void** end, const sort_compare_t* compare, int bad_allowed, int leftmost)
+{
+    while (1) {
+        size_t size = (size_t) (end - begin);
+        if (size < INSERTION_SORT_THRESHOLD) {
+            if (leftmost) {
+                sort_insertion(begin, end, compare);
+            } else {
+                sort_insertion_unguarded(begin, end, compare);
+            }
+
+            return;
+        }
+
+        size_t half = size / 2;
+        if (size > NINTHER_THRESHOLD) {
+            sort_3(begin, begin + half, end - 1, compare);
+            sort_3(begin + 1, begin + (half - 1), end - 2, compare);
+            sort_3(begin + 2, begin + (half + 1), end - 3, compare);
+            sort_3(begin + (half - 1), begin + half, begin + (half + 1), compare);
+            sort_swap(begin, begin + half);
+        } else {
+            sort_3(begin + half, begin, end - 1, compare);
+        }
+
+        if (!leftmost && sort_compare(compare, *(begin - 1), *begin) >= 0) {
+            begin = sort_partition_left(begin, end, compare) + 1;
+            continue;
+        }
+
+        int already_partitioned = 0;
+        const void** pivot = sort_partition_right(begin, end, compare, &already_partitioned);
+        size_t l_size = (size_t) (pivot - begin);
+        size_t r_size = (size_t) (end - (pivot + 1));
+        if (l_size < size / 8 || r_size < size / 8) {
+            if (--bad_allowed == 0) {
+                sort_heapsort(begin, end, compare);
+                return;
+            }
+
+            sort_shuffle(begin, pivot, l_size);
+            sort_shuffle(pivot + 1, end, r_size);
+        } else if (already_partitioned && sort_insertion_partial(begin, pivot, compare)
+            && sort_insertion_partial(pivot + 1, end, compare)) {
+            return;
+        }
+
+        if (l_size < r_size) {
+            sort_pdq(begin, pivot, compare, bad_allowed, leftmost);
+            begin = pivot + 1;
+            leftmost = 0;
+        } else {
+            sort_pdq(pivot + 1, end, compare, bad_allowed, 0);
+            end = pivot;
+        }
+    }
+}
+
+static void sort_unstable_with(const void** values, size_t size, const sort_compare_t* compare)
+{
+    if (size < 2) {
+        return;
+    }
+
+    int bad_allowed = 0;
+    for (size_t i = size; i > 1; i >>= 1) {
+        bad_allowed++;
+    }
+
+    sort_pdq(values, values + size, compare, bad_allowed, 1);
+}
+
+void sort_unstable(const void** values, size_t size, compare_t compare)
+{
+    sort_compare_t order = { compare, NULL, NULL };
+    sort_unstable_with(values, size, &order);
+}
+
+void sort_unstable_ctx(const void** values, size_t size, compare_ctx_t compare, void* ctx)
+{
+    sort_compare_t order = { NULL, compare, ctx };
+    sort_unstable_with(values, size, &order);
+}
+
+/**
+ * Run of a stable sort, sorted values at `[base, base + size)`.
+ */
+typedef struct sort_run_t {
+    size_t base;
+    size_t size;
+} sort_run_t;
+
+/**
+ * State of a stable sort: the stack of runs pending a merge and the scratch
+ * buffer merges copy their smaller run to.
+ * `min_gallop` is how many values in a row must come from the same run
+ * before merges switch to galloping, adapted to how well galloping pays.
+ */
+typedef struct sort_merge_t {
+    const void** values;
+    size_t size;
+    compare_t compare;
+    const void** buffer;
+    size_t buffer_size;
+    size_t min_gallop;
+    sort_run_t runs[MAX_RUNS];
+    size_t count;
+} sort_merge_t;
+
+/**
+ * Returns the length of the run at the start of the range, reversing it if
+ * it's strictly descending.
+ */
+static size_t sort_count_run(const void** values, size_t size, compare_t compare)
+{
+    if (size < 2) {
+        return size;
+    }
+
+    size_t run = 2;
+    if (compare(values[1], values[0]) < 0) {
+        while (run < size && compare(values[run], values[run - 1]) < 0) {
+            run++;
+        }
+
+        for (size_t i = 0, j = run - 1; i < j; i++, j--) {
+            sort_swap(values + i, values + j);
+        }
+    } else {
+        while (run < size && compare(values[run], values[run - 1]) >= 0) {
+            run++;
+        }
+    }
+
+    return run;
+}
+
+/**
+ * Stable insertion sort of a range whose first `sorted` values are sorted,
+ * finding where each value goes by binary search.
+ */
+static void sort_insertion_binary(const void** values, size_t size, size_t sorted, compare_t compare)
+{
+    for (size_t i = sorted; i < size; i++) {
+        const void* value = values[i];
+        size_t lo = 0;
+        size_t hi = i;
+        while (lo < hi) {
+            size_t mid = lo + (hi - lo) / 2;
+            if (compare(value, values[mid]) < 0) {
+                hi = mid;
+            } else {
+                lo = mid + 1;
+            }
+        }
+
+        memmove(values + lo + 1, values + lo, (i - lo) * sizeof(const void*));
+        values[lo] = value;
+    }
+}
+
+/**
+ * Returns the minimum run length for the given number of values, between
+ * `MIN_MERGE / 2` and `MIN_MERGE`, such that the number of runs is a power
+ * of 2 or a little less, which keeps the merges balanced.
+ */
+static size_t sort_min_run(size_t size)
+{
+    size_t rest = 0;
+    while (size >= MIN_MERGE) {
+        rest |= size & 1;
+        size >>= 1;
+    }
+
+    return size + rest;
+}
+
+/**
+ * Returns where `key` goes in the sorted range: before the values equal to
+ * it, or after them if `after` is set.
+ * The search gallops from `hint` by offsets of 1, 3, 7, ... before
+ * bisecting, so it takes O(log d) comparisons to land d values away.
+ */
+static size_t sort_gallop(const void* key, const void** values, size_t size, size_t hint, compare_t compare, int after)
+{
+    size_t lo;
+    size_t hi;
+    int cmp = compare(key, values[hint]);
+    if (cmp > 0 || (after && cmp == 0)) {
+        size_t last = 0;
+        size_t offset = 1;
+        size_t max = size - hint;
+        while (offset < max) {
+            cmp = compare(key, values[hint + offset]);
+            if (cmp < 0 || (!after && cmp == 0)) {
+                break;
+            }
+
+            last = offset;
+            offset = offset * 2 + 1;
+        }
+
+        lo = hint + last + 1;
+        hi = hint + (offset < max ? offset : max);
+    } else {
+        size_t last = 0;
+        size_t offset = 1;
+        size_t max = hint + 1;
+        while (offset < max) {
+            cmp = compare(key, values[hint - offset]);
+            if (cmp > 0 || (after && cmp == 0)) {
+                break;
+            }
+
+            last = offset;
+            offset = offset * 2 + 1;
+        }
+
+        lo = hint + 1 - (offset < max ? offset : max);
+        hi = hint - last;
+    }
+
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        cmp = compare(key, values[mid]);
+        if (cmp > 0 || (after && cmp == 0)) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+
+    return lo;
+}
+
+/**
+ * Makes room for `size` values in the scratch buffer, which never needs
+ * more than half the values.
+ * Returns 0 on success or -1 on error (out of memory).
+ */
+static int sort_reserve(sort_merge_t* merge, size_t size)
+{
+    if (size <= merge->buffer_size) {
+        return 0;
+    }
+
+    size_t capacity = merge->buffer_size * 2;
+    if (capacity < size) {
+        capacity = size;
+    }
+
+    if (capacity > merge->size / 2) {
+        capacity = merge->size / 2;
+    }
+
+    const void** buffer = (const void**) realloc(merge->buffer, capacity * sizeof(const void*));
+    if (buffer == NULL) {
+        return -1;
+    }
+
+    merge->buffer = buffer;
+    merge->buffer_size = capacity;
+    return 0;
+}
+
+/**
+ * Merges the adjacent runs `a` and `b` from left to right, `a` being the
+ * smaller and copied out to the buffer.
+ * `b[0]` must go before `a[0]` and `a[a_size - 1]` after all of `b`.
+ */
+static void sort_merge_lo(sort_merge_t* merge, size_t base, size_t a_size, size_t b_size)
+{
+    compare_t compare = merge->compare;
+    const void** a = merge->buffer;
+    const void** b = merge->values + base + a_size;
+    const void** dst = merge->values + base;
+    size_t i = 0;
+    size_t j = 0;
+    size_t min_gallop = merge->min_gallop;
+    size_t count_a = 0;
+    size_t count_b = 0;
+    int galloping = 0;
+    memcpy(a, dst, a_size * sizeof(const void*));
+    *dst++ = b[j++];
+    while (j < b_size && a_size - i > 1) {
+        if (!galloping) {
+            if (compare(b[j], a[i]) < 0) {
+                *dst++ = b[j++];
+                count_a = 0;
+                count_b++;
+            } else {
+                *dst++ = a[i++];
+                count_a++;
+                count_b = 0;
+            }
+
+            galloping = count_a >= min_gallop || count_b >= min_gallop;
+        } else {
+            count_a = sort_gallop(b[j], a + i, a_size - i, 0, compare, 1);
+            memcpy(dst, a + i, count_a * sizeof(const void*));
+            dst += count_a;
+            i += count_a;
+            if (a_size - i <= 1) {
+                break;
+            }
+
+            *dst++ = b[j++];
+            if (j == b_size) {
+                break;
+            }
+
+            count_b = sort_gallop(a[i], b + j, b_size - j, 0, compare, 0);
+            memmove(dst, b + j, count_b * sizeof(const void*));
+            dst += count_b;
+            j += count_b;
+            if (j == b_size) {
+                break;
+            }
+
+            *dst++ = a[i++];
+            if (min_gallop > 1) {
+                min_gallop--;
+            }
+
+            if (count_a < MIN_GALLOP && count_b < MIN_GALLOP) {
+                galloping = 0;
+                count_a = 0;
+                count_b = 0;
+                min_gallop += 2;
+            }
+        }
+    }
+
+    merge->min_gallop = min_gallop;
+    if (a_size - i == 1 && j < b_size) {
+        memmove(dst, b + j, (b_size - j) * sizeof(const void*));
+        dst[b_size - j] = a[i];
+    } else {
+        memcpy(dst, a + i, (a_size - i) * sizeof(const void*));
+    }
+}
+
+/**
+ * Merges the adjacent runs `a` and `b` from right to left, `b` being the
+ * smaller and copied out to the buffer.
+ * `b[0]` must go before `a[0]` and `a[a_size - 1]` after all of `b`.
+ */
+static void sort_merge_hi(sort_merge_t* merge, size_t base, size_t a_size, size_t b_size)
+{
+    compare_t compare = merge->compare;
+    const void** a = merge->values + base;
+    const void** b = merge->buffer;
+    const void** dst = merge->values + base + a_size + b_size;
+    size_t i = a_size;
+    size_t j = b_size;
+    size_t min_gallop = merge->min_gallop;
+    size_t count_a = 0;
+    size_t count_b = 0;
+    int galloping = 0;
+    memcpy(b, a + a_size, b_size * sizeof(const void*));
+    *--dst = a[--i];
+    while (i > 0 && j > 1) {
+        if (!galloping) {
+            if (compare(b[j - 1], a[i - 1]) < 0) {
+                *--dst = a[--i];
+                count_a++;
+                count_b = 0;
+            } else {
+                *--dst = b[--j];
+                count_a = 0;
+                count_b++;
+            }
+
+            galloping = count_a >= min_gallop || count_b >= min_gallop;
+        } else {
+            count_a = i - sort_gallop(b[j - 1], a, i, i - 1, compare, 1);
+            dst -= count_a;
+            i -= count_a;
+            memmove(dst, a + i, count_a * sizeof(const void*));
+            if (i == 0) {
+                break;
+            }
+
+            *--dst = b[--j];
+            if (j == 1) {
+                break;
+            }
+
+            count_b = j - sort_gallop(a[i - 1], b, j, j - 1, compare, 0);
+            dst -= count_b;
+            j -= count_b;
+            memcpy(dst, b + j, count_b * sizeof(const void*));
+            if (j <= 1) {
+                break;
+            }
+
+            *--dst = a[--i];
+            if (min_gallop > 1) {
+                min_gallop--;
+            }
+
+            if (count_a < MIN_GALLOP && count_b < MIN_GALLOP) {
+                galloping = 0;
+                count_a = 0;
+                count_b = 0;
+                min_gallop += 2;
+            }
+        }
+    }
+
+    merge->min_gallop = min_gallop;
+    if (j == 1 && i > 0) {
+        dst -= i;
+        memmove(dst, a, i * sizeof(const void*));
+        dst[-1] = b[0];
+    } else {
+        memcpy(dst - j, b, j * sizeof(const void*));
+    }
+}
+
+/**
+ * Merges the runs at `pos` and `pos + 1` of the stack.
+ * Values of the first run going before all of the second and values of the
+ * second going after all of the first are left where they are, then the
+ * smaller of what's left of the runs is copied out and merged back.
+ * Returns 0 on success or -1 on error (out of memory).
+ */
+static int sort_merge_at(sort_merge_t* merge, size_t pos)
+{
+    sort_run_t a = merge->runs[pos];
+    sort_run_t b = merge->runs[pos + 1];
+    const void** values = merge->values;
+    size_t skip = sort_gallop(values[b.base], values + a.base, a.size, 0, merge->compare, 1);
+    a.base += skip;
+    a.size -= skip;
+    if (a.size > 0) {
+        b.size = sort_gallop(values[a.base + a.size - 1], values + b.base, b.size, b.size - 1, merge->compare, 0);
+    }
+
+    if (a.size > 0 && b.size > 0) {
+        if (sort_reserve(merge, a.size < b.size ? a.size : b.size) != 0) {
+            return -1;
+        }
+
+        if (a.size <= b.size) {
+            sort_merge_lo(merge, a.base, a.size, b.size);
+        } else {
+            sort_merge_hi(merge, a.base, a.size, b.size);
+        }
+    }
+
+    merge->runs[pos].size += merge->runs[pos + 1].size;
+    if (pos + 3 == merge->count) {
+        merge->runs[pos + 1] = merge->runs[pos + 2];
+    }
+
+    merge->count--;
+    return 0;
+}
+
+/**
+ * Merges runs at the top of the stack until, from the top, every run is
+ * smaller than the one below it and than the two below it together.
+ * Run sizes then grow at least as fast as Fibonacci numbers down the stack,
+ * which bounds its height and keeps the merges balanced.
+ * Returns 0 on success or -1 on error (out of memory).
+ */
+static int sort_merge_collapse(sort_merge_t* merge)
+{
+    sort_run_t* runs = merge->runs;
+    while (merge->count > 1) {
+        size_t n = merge->count - 2;
+        if ((n > 0 && runs[n - 1].size <= runs[n].size + runs[n + 1].size)
+            || (n > 1 && runs[n - 2].size <= runs[n - 1].size + runs[n].size)) {
+            if (runs[n - 1].size < runs[n + 1].size) {
+                n--;
+            }
+        } else if (runs[n].size > runs[n + 1].size) {
+            break;
+        }
+
+        if (sort_merge_at(merge, n) != 0) {
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * Merges all the runs left on the stack.
+ * Returns 0 on success or -1 on error (out of memory).
+ */
+static int sort_merge_force_collapse(sort_merge_t* merge)
+{
+    sort_run_t* runs = merge->runs;
+    while (merge->count > 1) {
+        size_t n = merge->count - 2;
+        if (n > 0 && runs[n - 1].size < runs[n + 1].size) {
+            n--;
+        }
+
+        if (sort_merge_at(merge, n) != 0) {
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+int sort_stable(const void** values, size_t size, compare_t compare)
+{
+    if (size < MIN_MERGE) {
+        sort_insertion_binary(values, size, sort_count_run(values, size, compare), compare);
+        return 0;
+    }
+
+    sort_merge_t merge;
+    merge.values = values;
+    merge.size = size;
+    merge.compare = compare;
+    merge.buffer = NULL;
+    merge.buffer_size = 0;
+    merge.min_gallop = MIN_GALLOP;
+    merge.count = 0;
+
+    int result = 0;
+    size_t min_run = sort_min_run(size);
+    for (size_t base = 0; base < size && result == 0;) {
+        size_t run = sort_count_run(values + base, size - base, compare);
+        if (run < min_run) {
+            size_t forced = size - base < min_run ? size - base : min_run;
+            sort_insertion_binary(values + base, forced, run, compare);
+            run = forced;
+        }
+
+        merge.runs[merge.count].base = base;
+        merge.runs[merge.count].size = run;
+        merge.count++;
+        result = sort_merge_collapse(&merge);
+        base += run;
+    }
+
+    if (result == 0) {
+        result = sort_merge_force_collapse(&merge);
+    }
+
+    free(merge.buffer);
+    return result;
+}
+
+/**
+ * Value of a sort by key alongside its key, so that sorting never goes
+ * back to the value.
+ */
+typedef struct sort_pair_t {
+    uint64_t key;
+    const void* value;
+} sort_pair_t;
+
+static void sort_insertion_pairs(sort_pair_t* pairs, size_t size)
+{
+    for (size_t i = 1; i < size; i++) {
+        sort_pair_t pair = pairs[i];
+        size_t j = i;
+        while (j > 0 && pair.key < pairs[j - 1].key) {
+            pairs[j] = pairs[j - 1];
+            j--;
+        }
+
+        pairs[j] = pair;
+    }
+}
+
+/**
+ * LSD radix sort of the pairs by key, a byte at a time, ping-ponging
+ * between `pairs` and `buffer`.
+ * The counts of all the bytes are taken in a single pass, and the passes
+ * for bytes that all keys share are skipped, so keys spanning a small range
+ * take fewer passes.
+ * Returns the array ending up sorted.
+ */
+static sort_pair_t* sort_radix_pairs(sort_pair_t* pairs, sort_pair_t* buffer, size_t size)
+{
+    size_t counts[RADIX_PASSES][RADIX_SIZE] = { { 0 } };
+    for (size_t i = 0; i < size; i++) {
+        for (size_t pass = 0; pass < RADIX_PASSES; pass++) {
+            counts[pass][(pairs[i].key >> (pass * RADIX_BITS)) & (RADIX_SIZE - 1)]++;
+        }
+    }
+
+    sort_pair_t* src = pairs;
+    sort_pair_t* dst = buffer;
+    for (size_t pass = 0; pass < RADIX_PASSES; pass++) {
+        size_t shift = pass * RADIX_BITS;
+        size_t* count = counts[pass];
+        if (count[(src[0].key >> shift) & (RADIX_SIZE - 1)] == size) {
+            continue;
+        }
+
+        size_t offset = 0;
+        for (size_t digit = 0; digit < RADIX_SIZE; digit++) {
+            size_t next = offset + count[digit];
+            count[digit] = offset;
+            offset = next;
+        }
+
+        for (size_t i = 0; i < size; i++) {
+            dst[count[(src[i].key >> shift) & (RADIX_SIZE - 1)]++] = src[i];
+        }
+
+        sort_pair_t* tmp = src;
+        src = dst;
+        dst = tmp;
+    }
+
+    return src;
+}
+
+int sort_by_key(const void** values, size_t size, sort_key_t key, void* ctx)
+{
+    if (size < 2) {
+        return 0;
+    }
+
+    if (size > SIZE_MAX / (2 * sizeof(sort_pair_t))) {
+        return -1;
+    }
+
+    sort_pair_t* pairs = (sort_pair_t*) malloc(2 * size * sizeof(sort_pair_t));
+    if (pairs == NULL) {
+        return -1;
+    }
+
+    int ordered = 1;
+    for (size_t i = 0; i < size; i++) {
+        pairs[i].key = key(values[i], ctx);
+        pairs[i].value = values[i];
+        ordered &= i == 0 || pairs[i - 1].key <= pairs[i].key;
+    }
+
+    if (!ordered) {
+        sort_pair_t* sorted = pairs;
+        if (size < RADIX_THRESHOLD) {
+            sort_insertion_pairs(pairs, size);
+        } else {
+            sorted = sort_radix_pairs(pairs, pairs + size, size);
+        }
+
+        for (size_t i = 0; i < size; i++) {
+            values[i] = sorted[i].value;
+        }
+    }
+
+    free(pairs);
+    return 0;
+}
+
+#if !defined(_WIN32)
+
+/**
+ * Share of a parallel sort given to a thread.
+ * Every thread works on the output range `[begin, end)` of the current pass,
+ * so the work is balanced however the values are distributed.
+ * Runs are delimited by `bounds`, `runs + 1` of them.
+ */
+typedef struct sort_task_t {
+    const void** src;
+    const void** dst;
+    const size_t* bounds;
+    size_t runs;
+    size_t begin;
+    size_t end;
+    compare_t compare;
+    void* (*run)(void*);
+} sort_task_t;
+
+static void* sort_task_sort(void* arg)
+{
+    sort_task_t* task = (sort_task_t*) arg;
+    sort_unstable(task->src + task->begin, task->end - task->begin, task->compare);
+    return NULL;
+}
+
+static void* sort_task_copy(void* arg)
+{
+    sort_task_t* task = (sort_task_t*) arg;
+    memcpy(task->dst + task->begin, task->src + task->begin, (task->end - task->begin) * sizeof(const void*));
+    return NULL;
+}
+
+/**
+ * Returns how many of the first `rank` values of the merge of `a` and `b`
+ * come from `a`, values of `a` going first on ties.
+ */
+static size_t sort_co_rank(size_t rank, const void** a, size_t a_size, const void** b, size_t b_size, compare_t compare)
+{
+    size_t lo = rank > b_size ? rank - b_size : 0;
+    size_t hi = rank < a_size ? rank : a_size;
+    while (lo < hi) {
+        size_t i = lo + (hi - lo) / 2;
+        size_t j = rank - i;
+        if (j > 0 && compare(b[j - 1], a[i]) >= 0) {
+            lo = i + 1;
+        } else {
+            hi = i;
+        }
+    }
+
+    return lo;
+}
+
+/**
+ * Merges the pairs of runs of `src` into `dst`, only writing the values
+ * landing in the task's output range.
+ * A last run without a pair is copied.
+ */
+static void* sort_task_merge(void* arg)
+{
+    sort_task_t* task = (sort_task_t*) arg;
+    for (size_t r = 0; r < task->runs; r += 2) {
+        size_t lo = task->bounds[r];
+        size_t mid = task->bounds[r + 1];
+        size_t hi = r + 2 <= task->runs ? task->bounds[r + 2] : mid;
+        size_t begin = task->begin > lo ? task->begin : lo;
+        size_t end = task->end < hi ? task->end : hi;
+        if (begin >= end) {
+            continue;
+        }
+
+        const void** a = task->src + lo;
+        const void** b = task->src + mid;
+        size_t a_size = mid - lo;
+        size_t b_size = hi - mid;
+        size_t i = sort_co_rank(begin - lo, a, a_size, b, b_size, task->compare);
+        size_t j = begin - lo - i;
+        for (size_t k = begin; k < end; k++) {
+            if (j == b_size || (i < a_size && task->compare(b[j], a[i]) >= 0)) {
+                task->dst[k] = a[i++];
+            } else {
+                task->dst[k] = b[j++];
+            }
+        }
+    }
+
+    return NULL;
+}
+
+/**
+ * Runs the given tasks, each on its own thread but the first, which runs on
+ * the calling thread like any task whose thread can't be created.
+ */
+static void sort_run_tasks(sort_task_t* tasks, size_t count)
+{
+    pthread_t threads[MAX_THREADS];
+    int started[MAX_THREADS];
+    for (size_t i = 1; i < count; i++) {
+        started[i] = pthread_create(&threads[i], NULL, tasks[i].run, &tasks[i]) == 0;
+    }
+
+    tasks[0].run(&tasks[0]);
+    for (size_t i = 1; i < count; i++) {
+        if (started[i]) {
+            pthread_join(threads[i], NULL);
+        } else {
+            tasks[i].run(&tasks[i]);
+        }
+    }
+}
+
+/**
+ * Parallel merge sort: the values are cut into one run per thread, the runs
+ * sorted with `sort_unstable()` and merged pairwise into a buffer and back.
+ * Each merge pass splits its output evenly between the threads, finding
+ * where every share starts in the runs by binary search, so all of them are
+ * busy until the last merge.
+ */
+static int sort_merge_parallel(const void** values, size_t size, compare_t compare, size_t threads)
+{
+    const void** buffer = (const void**) malloc(size * sizeof(const void*));
+    if (buffer == NULL) {
+        return -1;
+    }
+
+    size_t bounds[MAX_THREADS + 1];
+    sort_task_t tasks[MAX_THREADS];
+    for (size_t i = 0; i <= threads; i++) {
+        bounds[i] = size / threads * i + (i < size % threads ? i : size % threads);
+    }
+
+    for (size_t i = 0; i < threads; i++) {
+        tasks[i].src = values;
+        tasks[i].dst = buffer;
+        tasks[i].bounds = bounds;
+        tasks[i].runs = threads;
+        tasks[i].begin = bounds[i];
+        tasks[i].end = bounds[i + 1];
+        tasks[i].compare = compare;
+        tasks[i].run = sort_task_sort;
+    }
+
+    sort_run_tasks(tasks, threads);
+    const void** src = values;
+    const void** dst = buffer;
+    for (size_t runs = threads; runs > 1; runs = (runs + 1) / 2) {
+        for (size_t i = 0; i < threads; i++) {
+            tasks[i].src = src;
+            tasks[i].dst = dst;
+            tasks[i].runs = runs;
+            tasks[i].run = sort_task_merge;
+        }
+
+        sort_run_tasks(tasks, threads);
+        for (size_t i = 0; i <= runs / 2; i++) {
+            bounds[i] = bounds[i * 2 < runs ? i * 2 : runs];
+        }
+
+        bounds[(runs + 1) / 2] = size;
+        const void** tmp = src;
+        src = dst;
+        dst = tmp;
+    }
+
+    if (src != values) {
+        for (size_t i = 0; i < threads; i++) {
+            tasks[i].src = src;
+            tasks[i].dst = values;
+            tasks[i].run = sort_task_copy;
+        }
+
+        sort_run_tasks(tasks, threads);
+    }
+
+    free(buffer);
+    return 0;
+}
+
+#endif
+
+void sort_parallel(const void** values, size_t size, compare_t compare, size_t threads)
+{
+#if !defined(_WIN32)
+    if (threads == 0) {
+        long online = sysconf(_SC_NPROCESSORS_ONLN);
+        threads = online > 0 ? (size_t) online : 1;
+    }
+
+    if (threads > size / PARALLEL_MIN_RUN) {
+        threads = size / PARALLEL_MIN_RUN;
+    }
+
+    if (threads > MAX_THREADS) {
+        threads = MAX_THREADS;
+    }
+
+    if (threads > 1 && sort_merge_parallel(values, size, compare, threads) == 0) {
+        return;
+    }
+#else
+    (void) threads;
+#endif
+
+    sort_unstable(values, size, compare);
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include "marlo/sorting.h"
+#include <stddef.h>
+
+/**
+ * Sorts the given array of values in place with pattern-defeating quicksort.
+ * Pivots are a median of 3 (ninther for large ranges), small ranges are
+ * insertion sorted and ranges that keep partitioning badly are heapsorted,
+ * so the worst case is O(n log n) and sorted, reversed or repetitive inputs
+ * run in close to linear time.
+ * The sort isn't stable.
+ */
+void sort_unstable(const void** values, size_t size, compare_t compare);
+
+/**
+ * Sorts the given array of values like `sort_unstable()`, calling the given
+ * compare function with `ctx`.
+ */
+void sort_unstable_ctx(const void** values, size_t size, compare_ctx_t compare, void* ctx);
+
+/**
+ * Sorts the given array of values in place with a stable, natural merge
+ * sort in the manner of timsort.
+ * Ascending and strictly descending runs already in the values are found
+ * and kept, short ones extended by binary insertion sort, then the runs are
+ * merged with galloping, so presorted data, or data made of a few sorted
+ * pieces, sorts in close to linear time.
+ * Merges take a buffer of at most `size / 2` pointers.
+ * Returns 0 on success or -1 on error (out of memory), in which case the
+ * values are left in an unspecified order.
+ */
+int sort_stable(const void** values, size_t size, compare_t compare);
+
+/**
+ * Sorts the given array of values in place by the keys `key` returns for
+ * them, calling it once per value.
+ * Values are sorted as (key, value) pairs, with insertion sort for small
+ * arrays and LSD radix sort otherwise, then written back in order, so the
+ * sort takes O(n) time and never compares values; values whose keys are
+ * already in order are left as they are after the keys are taken.
+ * The sort is stable, and takes a buffer of `2 * size` pairs.
+ * Returns 0 on success or -1 on error (out of memory), in which case the
+ * values are left untouched.
+ */
+int sort_by_key(const void** values, size_t size, sort_key_t key, void* ctx);
+
+/**
+ * Sorts the given array of values in place on up to `threads` threads (0 for
+ * one per online processor), with a parallel merge sort of runs sorted by
+ * `sort_unstable()`.
+ * Small arrays, and arrays that can't get the extra `size` pointers of
+ * buffer, are sorted on the calling thread, as are all of them on systems
+ * without POSIX threads.
+ * `compare` is called from several threads at once.
+ * The sort isn't stable.
+ */
+void sort_parallel(const void** values, size_t size, compare_t compare, size_t threads);
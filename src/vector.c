@@ -1,4 +1,5 @@
 #include "marlo/vector.h"
+#include "sort.h"
 
 #include <stdlib.h>
 
@@ -112,6 +113,19 @@ int vector_foreach(const vector_t* vector, callback_t on_value)
     return 0;
 }
 
+int vector_foreach_ctx(const vector_t* vector, callback_ctx_t on_value, void* ctx)
+{
+    if (vector == NULL || on_value == NULL) {
+        return -1;
+    }
+
+    for (size_t i = 0; i < vector->size; i++) {
+        on_value(vector->values[i], ctx);
+    }
+
+    return 0;
+}
+
 int vector_is_empty(const vector_t* vector)
 {
     return vector_size(vector) == 0;
@@ -150,46 +164,51 @@ size_t vector_capacity(const vector_t* vector)
     return vector != NULL ? vector->capacity : 0;
 }
 
-static void vector_swap(vector_t* vector, size_t i, size_t j)
+int vector_sort(vector_t* vector, compare_t compare)
 {
-    const void* value = vector->values[i];
-    vector->values[i] = vector->values[j];
-    vector->values[j] = value;
+    if (vector == NULL || compare == NULL) {
+        return -1;
+    }
+
+    sort_unstable(vector->values, vector->size, compare);
+    return 0;
 }
 
-static size_t vector_partition(vector_t* vector, size_t i, size_t j, compare_t compare)
+int vector_sort_ctx(vector_t* vector, compare_ctx_t compare, void* ctx)
 {
-    i--;
-    size_t pivot = j;
-    for (size_t k = i + 1; k < j; k++) {
-        if (compare(vector->values[k], vector->values[pivot]) < 0) {
-            vector_swap(vector, ++i, k);
-        }
+    if (vector == NULL || compare == NULL) {
+        return -1;
     }
 
-    vector_swap(vector, i + 1, j);
-    return i + 1;
+    sort_unstable_ctx(vector->values, vector->size, compare, ctx);
+    return 0;
 }
 
-static void vector_quicksort(vector_t* vector, size_t i, size_t j, compare_t compare)
+int vector_stable_sort(vector_t* vector, compare_t compare)
 {
-    if (i < j) {
-        size_t pivot = vector_partition(vector, i, j, compare);
-        vector_quicksort(vector, i, pivot - 1, compare);
-        vector_quicksort(vector, pivot + 1, j, compare);
+    if (vector == NULL || compare == NULL) {
+        return -1;
     }
+
+    return sort_stable(vector->values, vector->size, compare);
 }
 
-int vector_sort(vector_t* vector, compare_t compare)
+int vector_sort_by_key(vector_t* vector, sort_key_t key, void* ctx)
 {
-    if (vector == NULL || compare == NULL) {
+    if (vector == NULL || key == NULL) {
         return -1;
     }
 
-    if (vector->size > 1) {
-        vector_quicksort(vector, 0, vector->size - 1, compare);
+    return sort_by_key(vector->values, vector->size, key, ctx);
+}
+
+int vector_sort_parallel(vector_t* vector, compare_t compare, size_t threads)
+{
+    if (vector == NULL || compare == NULL) {
+        return -1;
     }
 
+    sort_parallel(vector->values, vector->size, compare, threads);
     return 0;
 }
 
@@ -0,0 +1,14 @@
+#pragma once
+
+#include <stdio.h>
+
+/**
+ * Fails the current test function, returning 1 from it, if `cond` is false.
+ */
+#define CHECK(cond)                                                             \
+    do {                                                                        \
+        if (!(cond)) {                                                          \
+            fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+            return 1;                                                           \
+        }                                                                       \
+    } while (0)
@@ -0,0 +1,196 @@
+#include "check.h"
+#include "marlo/concurrent_hash_table.h"
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#define KEY(i) ((const void*) (uintptr_t) ((i) * 8 + 8))
+#define WRITERS 4
+#define READERS 2
+#define WRITER_KEYS 20000
+#define SHARED_KEYS 5000
+
+/**
+ * Thread state, writers own the keys from `first` to `first + WRITER_KEYS`
+ * and publish how far they got in `done`.
+ */
+typedef struct task_t {
+    concurrent_hash_table_t* table;
+    size_t first;
+    atomic_size_t done;
+    int failed;
+} task_t;
+
+static task_t writers[WRITERS];
+static atomic_int running;
+static char shared_keys[SHARED_KEYS][16];
+
+static int write_keys(task_t* task)
+{
+    for (size_t i = 0; i < WRITER_KEYS; i++) {
+        CHECK(concurrent_hash_table_push(task->table, KEY(task->first + i), KEY(task->first + i)) == 0);
+        atomic_store_explicit(&task->done, i + 1, memory_order_release);
+    }
+
+    for (size_t i = 0; i < WRITER_KEYS; i += 2) {
+        concurrent_hash_table_remove(task->table, KEY(task->first + i));
+    }
+
+    return 0;
+}
+
+static void* write_run(void* arg)
+{
+    task_t* task = (task_t*) arg;
+    task->failed = write_keys(task);
+    return NULL;
+}
+
+/**
+ * Looks up the keys the writers have published so far: odd ones are never
+ * removed, even ones may be gone already but can't hold another value, and
+ * keys past the last writer's range were never pushed.
+ */
+static int read_keys(task_t* task)
+{
+    uint64_t state = task->first + 1;
+    while (atomic_load_explicit(&running, memory_order_acquire)) {
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+
+        const task_t* writer = &writers[state % WRITERS];
+        size_t done = atomic_load_explicit(&writer->done, memory_order_acquire);
+        if (done > 0) {
+            size_t key = writer->first + (size_t) (state >> 8) % done;
+            const void* value = concurrent_hash_table_at(task->table, KEY(key));
+            CHECK(value == KEY(key) || (value == NULL && key % 2 == 0));
+        }
+
+        CHECK(concurrent_hash_table_at(task->table, KEY(WRITERS * WRITER_KEYS + state % 1000)) == NULL);
+    }
+
+    return 0;
+}
+
+static void* read_run(void* arg)
+{
+    task_t* task = (task_t*) arg;
+    task->failed = read_keys(task);
+    return NULL;
+}
+
+/**
+ * Runs writers growing the table from its smallest capacity, then removing
+ * every other key of theirs, while readers keep looking keys up.
+ */
+static int test_readers_writers(void)
+{
+    concurrent_hash_table_t* table = concurrent_hash_table_new(HASH_TABLE_ADDRESS, 0);
+    CHECK(table != NULL);
+
+    for (size_t i = 0; i < WRITERS; i++) {
+        writers[i].table = table;
+        writers[i].first = i * WRITER_KEYS;
+        atomic_init(&writers[i].done, 0);
+        writers[i].failed = 0;
+    }
+
+    task_t readers[READERS];
+    pthread_t threads[WRITERS + READERS];
+    atomic_store(&running, 1);
+    for (size_t i = 0; i < READERS; i++) {
+        readers[i].table = table;
+        readers[i].first = i;
+        readers[i].failed = 0;
+        CHECK(pthread_create(&threads[WRITERS + i], NULL, read_run, &readers[i]) == 0);
+    }
+
+    for (size_t i = 0; i < WRITERS; i++) {
+        CHECK(pthread_create(&threads[i], NULL, write_run, &writers[i]) == 0);
+    }
+
+    for (size_t i = 0; i < WRITERS; i++) {
+        pthread_join(threads[i], NULL);
+        CHECK(!writers[i].failed);
+    }
+
+    atomic_store(&running, 0);
+    for (size_t i = 0; i < READERS; i++) {
+        pthread_join(threads[WRITERS + i], NULL);
+        CHECK(!readers[i].failed);
+    }
+
+    concurrent_hash_table_reclaim(table);
+    CHECK(concurrent_hash_table_size(table) == WRITERS * WRITER_KEYS / 2);
+    for (size_t i = 0; i < WRITERS * WRITER_KEYS; i++) {
+        CHECK(concurrent_hash_table_at(table, KEY(i)) == (i % 2 == 1 ? KEY(i) : NULL));
+    }
+
+    concurrent_hash_table_release(table);
+    return 0;
+}
+
+static int push_shared(task_t* task)
+{
+    for (size_t i = 0; i < SHARED_KEYS; i++) {
+        size_t key = (i + task->first * SHARED_KEYS / WRITERS) % SHARED_KEYS;
+        CHECK(concurrent_hash_table_push(task->table, shared_keys[key], KEY(task->first)) == 0);
+    }
+
+    return 0;
+}
+
+static void* push_shared_run(void* arg)
+{
+    task_t* task = (task_t*) arg;
+    task->failed = push_shared(task);
+    return NULL;
+}
+
+/**
+ * Has every writer push the same string keys, starting at different ones,
+ * so they contend for the same shards: each key must end up once in the
+ * table, with the value of one of the writers.
+ */
+static int test_shared_keys(void)
+{
+    concurrent_hash_table_t* table = concurrent_hash_table_new(HASH_TABLE_STRING, 0);
+    CHECK(table != NULL);
+
+    for (size_t i = 0; i < SHARED_KEYS; i++) {
+        snprintf(shared_keys[i], sizeof(shared_keys[i]), "key-%zu", i);
+    }
+
+    pthread_t threads[WRITERS];
+    for (size_t i = 0; i < WRITERS; i++) {
+        writers[i].table = table;
+        writers[i].first = i;
+        writers[i].failed = 0;
+        CHECK(pthread_create(&threads[i], NULL, push_shared_run, &writers[i]) == 0);
+    }
+
+    for (size_t i = 0; i < WRITERS; i++) {
+        pthread_join(threads[i], NULL);
+        CHECK(!writers[i].failed);
+    }
+
+    CHECK(concurrent_hash_table_size(table) == SHARED_KEYS);
+    for (size_t i = 0; i < SHARED_KEYS; i++) {
+        uintptr_t value = (uintptr_t) concurrent_hash_table_at(table, shared_keys[i]);
+        CHECK(value >= (uintptr_t) KEY(0) && value <= (uintptr_t) KEY(WRITERS - 1) && value % 8 == 0);
+    }
+
+    concurrent_hash_table_release(table);
+    return 0;
+}
+
+int main(void)
+{
+    int failed = 0;
+    failed |= test_readers_writers();
+    failed |= test_shared_keys();
+    return failed;
+}
@@ -0,0 +1,96 @@
+#include "check.h"
+#include "marlo/frozen_hash_table.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#define PATH "frozen_hash_table_test.bin"
+#define KEY(i) ((const void*) (uintptr_t) ((i) * 16 + 16))
+
+static size_t value_size(const void* value, void* ctx)
+{
+    (void) value;
+    (void) ctx;
+    return sizeof(uint64_t);
+}
+
+/**
+ * Writes a multi-million-key table and maps it back.
+ */
+static int test_write_map_large(void)
+{
+    static uint64_t values[1 << 22];
+    size_t size = sizeof(values) / sizeof(values[0]);
+    hash_table_t* table = hash_table_new(HASH_TABLE_ADDRESS, size);
+    CHECK(table != NULL);
+
+    for (size_t i = 0; i < size; i++) {
+        values[i] = i * 3;
+        CHECK(hash_table_push(table, KEY(i), &values[i]) == 0);
+    }
+
+    CHECK(hash_table_write(table, PATH, value_size, NULL) == 0);
+    hash_table_release(table);
+
+    frozen_hash_table_t* frozen = frozen_hash_table_map(PATH);
+    CHECK(frozen != NULL);
+    CHECK(frozen_hash_table_size(frozen) == size);
+    for (size_t i = 0; i < size; i++) {
+        const uint64_t* value = (const uint64_t*) frozen_hash_table_at(frozen, KEY(i));
+        CHECK(value != NULL && *value == i * 3);
+    }
+
+    CHECK(frozen_hash_table_at(frozen, KEY(size)) == NULL);
+    frozen_hash_table_release(frozen);
+    remove(PATH);
+    return 0;
+}
+
+/**
+ * Drops the null byte ending the last value of a file, which must make that
+ * value missing rather than readable past the end of the mapping.
+ */
+static int test_map_corrupt_value(void)
+{
+    static const char* values[] = {"one", "two", "three", "four", "five"};
+    hash_table_t* table = hash_table_new(HASH_TABLE_ADDRESS, 0);
+    CHECK(table != NULL);
+    for (size_t i = 0; i < 5; i++) {
+        CHECK(hash_table_push(table, KEY(i), values[i]) == 0);
+    }
+
+    CHECK(hash_table_write(table, PATH, NULL, NULL) == 0);
+    hash_table_release(table);
+
+    FILE* file = fopen(PATH, "r+b");
+    CHECK(file != NULL);
+    CHECK(fseek(file, -1, SEEK_END) == 0);
+    CHECK(fputc('x', file) == 'x');
+    CHECK(fclose(file) == 0);
+
+    frozen_hash_table_t* frozen = frozen_hash_table_map(PATH);
+    CHECK(frozen != NULL);
+    size_t missing = 0;
+    for (size_t i = 0; i < 5; i++) {
+        const char* value = (const char*) frozen_hash_table_at(frozen, KEY(i));
+        if (value == NULL) {
+            missing++;
+        } else {
+            CHECK(strcmp(value, values[i]) == 0);
+        }
+    }
+
+    CHECK(missing == 1);
+    frozen_hash_table_release(frozen);
+    remove(PATH);
+    return 0;
+}
+
+int main(void)
+{
+    int failed = 0;
+    failed |= test_write_map_large();
+    failed |= test_map_corrupt_value();
+    return failed;
+}
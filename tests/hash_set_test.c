@@ -0,0 +1,331 @@
+#include "check.h"
+#include "marlo/hash_set.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#define KEY(i) ((const void*) (uintptr_t) ((i) * 8 + 8))
+#define LIMIT 2000
+#define STRINGS 3000
+
+/**
+ * Returns a new address set holding the multiples of `step` below `limit`.
+ */
+static hash_set_t* multiples(size_t step, size_t limit)
+{
+    hash_set_t* set = hash_set_new(0);
+    for (size_t i = 0; set != NULL && i < limit; i += step) {
+        if (hash_set_push(set, KEY(i)) == -1) {
+            hash_set_release(set);
+            return NULL;
+        }
+    }
+
+    return set;
+}
+
+/**
+ * Checks that `set` holds exactly the keys below `LIMIT` flagged in
+ * `expected`, looking each one up and iterating over the set.
+ */
+static int check_members(const hash_set_t* set, const char* expected)
+{
+    CHECK(set != NULL);
+
+    size_t size = 0;
+    for (size_t i = 0; i < LIMIT; i++) {
+        CHECK(hash_set_contains(set, KEY(i)) == expected[i]);
+        size += (size_t) expected[i];
+    }
+
+    CHECK(hash_set_size(set) == size);
+    size_t visited = 0;
+    for (hash_set_iterator_t it = hash_set_begin(set); hash_set_is_valid(it); it = hash_set_next(it)) {
+        uintptr_t value = (uintptr_t) hash_set_value(it);
+        CHECK(value % 8 == 0 && value / 8 - 1 < LIMIT && expected[value / 8 - 1]);
+        visited++;
+    }
+
+    CHECK(visited == size);
+    return 0;
+}
+
+/**
+ * Combines the even keys with the smaller set of multiples of 3 below 900,
+ * with each set on either side, so both the copy of the larger set and the
+ * iteration of the smaller one are exercised.
+ */
+static int test_algebra(void)
+{
+    hash_set_t* evens = multiples(2, LIMIT);
+    hash_set_t* threes = multiples(3, 900);
+    CHECK(evens != NULL && threes != NULL);
+
+    static char expected[LIMIT];
+    hash_set_t* sets[2] = {evens, threes};
+    for (size_t order = 0; order < 2; order++) {
+        const hash_set_t* set = sets[order];
+        const hash_set_t* other = sets[1 - order];
+
+        hash_set_t* result = hash_set_union(set, other);
+        for (size_t i = 0; i < LIMIT; i++) {
+            expected[i] = (char) (i % 2 == 0 || (i % 3 == 0 && i < 900));
+        }
+
+        CHECK(check_members(result, expected) == 0);
+        hash_set_release(result);
+
+        result = hash_set_intersect(set, other);
+        for (size_t i = 0; i < LIMIT; i++) {
+            expected[i] = (char) (i % 6 == 0 && i < 900);
+        }
+
+        CHECK(check_members(result, expected) == 0);
+        hash_set_release(result);
+
+        result = hash_set_difference(set, other);
+        for (size_t i = 0; i < LIMIT; i++) {
+            int in_evens = i % 2 == 0;
+            int in_threes = i % 3 == 0 && i < 900;
+            expected[i] = (char) (order == 0 ? in_evens && !in_threes : in_threes && !in_evens);
+        }
+
+        CHECK(check_members(result, expected) == 0);
+        hash_set_release(result);
+    }
+
+    for (size_t i = 0; i < LIMIT; i++) {
+        expected[i] = (char) (i % 2 == 0);
+    }
+
+    CHECK(check_members(evens, expected) == 0);
+    hash_set_release(evens);
+    hash_set_release(threes);
+    return 0;
+}
+
+/**
+ * Combines a set with an empty one, with itself, and rejects `NULL` sets
+ * and sets of different modes.
+ */
+static int test_algebra_edges(void)
+{
+    hash_set_t* evens = multiples(2, LIMIT);
+    hash_set_t* empty = hash_set_new(0);
+    hash_set_t* strings = hash_set_new_mode(HASH_TABLE_STRING, 0);
+    CHECK(evens != NULL && empty != NULL && strings != NULL);
+
+    static char expected[LIMIT];
+    static char none[LIMIT];
+    for (size_t i = 0; i < LIMIT; i++) {
+        expected[i] = (char) (i % 2 == 0);
+    }
+
+    hash_set_t* result = hash_set_union(empty, evens);
+    CHECK(check_members(result, expected) == 0);
+    hash_set_release(result);
+
+    result = hash_set_intersect(evens, empty);
+    CHECK(check_members(result, none) == 0);
+    hash_set_release(result);
+
+    result = hash_set_difference(evens, empty);
+    CHECK(check_members(result, expected) == 0);
+    hash_set_release(result);
+
+    result = hash_set_difference(empty, evens);
+    CHECK(check_members(result, none) == 0);
+    hash_set_release(result);
+
+    result = hash_set_union(evens, evens);
+    CHECK(check_members(result, expected) == 0);
+    hash_set_release(result);
+
+    result = hash_set_intersect(evens, evens);
+    CHECK(check_members(result, expected) == 0);
+    hash_set_release(result);
+
+    result = hash_set_difference(evens, evens);
+    CHECK(check_members(result, none) == 0);
+    hash_set_release(result);
+
+    CHECK(hash_set_union(evens, NULL) == NULL);
+    CHECK(hash_set_intersect(NULL, evens) == NULL);
+    CHECK(hash_set_union(evens, strings) == NULL);
+    CHECK(hash_set_intersect(strings, evens) == NULL);
+    CHECK(hash_set_difference(evens, strings) == NULL);
+
+    hash_set_release(evens);
+    hash_set_release(empty);
+    hash_set_release(strings);
+    return 0;
+}
+
+/**
+ * Removes elements from a set before combining it, so the copies made by the
+ * algebra start from a set with removed elements.
+ */
+static int test_algebra_after_remove(void)
+{
+    hash_set_t* evens = multiples(2, LIMIT);
+    hash_set_t* threes = multiples(3, LIMIT);
+    CHECK(evens != NULL && threes != NULL);
+
+    for (size_t i = 0; i < LIMIT; i += 4) {
+        hash_set_remove(evens, KEY(i));
+    }
+
+    static char expected[LIMIT];
+    hash_set_t* result = hash_set_union(evens, threes);
+    for (size_t i = 0; i < LIMIT; i++) {
+        expected[i] = (char) (i % 4 == 2 || i % 3 == 0);
+    }
+
+    CHECK(check_members(result, expected) == 0);
+    hash_set_release(result);
+
+    result = hash_set_difference(threes, evens);
+    for (size_t i = 0; i < LIMIT; i++) {
+        expected[i] = (char) (i % 3 == 0 && i % 4 != 2);
+    }
+
+    CHECK(check_members(result, expected) == 0);
+    hash_set_release(result);
+
+    hash_set_release(evens);
+    hash_set_release(threes);
+    return 0;
+}
+
+static char names[STRINGS][16];
+static char copies[STRINGS][16];
+
+/**
+ * Returns whether `value` points into `names`, at a name of the given
+ * parity, and not at a copy.
+ */
+static int is_name(const void* value, size_t parity)
+{
+    uintptr_t address = (uintptr_t) value;
+    uintptr_t first = (uintptr_t) names[0];
+    return address >= first && address - first < sizeof(names) && (address - first) % 16 == 0
+        && (address - first) / 16 % 2 == parity;
+}
+
+/**
+ * Fills a string set with names, then pushes copies of them from another
+ * buffer: elements must be found and removed by contents, the name pushed
+ * first must be the one kept, and the empty string is an element like the
+ * others.
+ */
+static int test_strings(void)
+{
+    for (size_t i = 0; i < STRINGS; i++) {
+        snprintf(names[i], sizeof(names[i]), "name-%zu", i);
+        memcpy(copies[i], names[i], sizeof(names[i]));
+    }
+
+    CHECK(hash_set_new_mode(HASH_TABLE_BYTES, 0) == NULL);
+    hash_set_t* set = hash_set_new_mode(HASH_TABLE_STRING, 0);
+    CHECK(set != NULL);
+    CHECK(hash_set_mode(set) == HASH_TABLE_STRING);
+
+    for (size_t i = 0; i < STRINGS; i++) {
+        CHECK(hash_set_push(set, names[i]) == 0);
+    }
+
+    for (size_t i = 0; i < STRINGS; i++) {
+        CHECK(hash_set_push(set, copies[i]) == 0);
+        CHECK(hash_set_contains(set, copies[i]));
+    }
+
+    CHECK(hash_set_size(set) == STRINGS);
+    CHECK(!hash_set_contains(set, "name-"));
+    CHECK(!hash_set_contains(set, ""));
+
+    CHECK(hash_set_push(set, "") == 0);
+    CHECK(hash_set_contains(set, ""));
+    hash_set_remove(set, "");
+    CHECK(!hash_set_contains(set, ""));
+
+    for (size_t i = 0; i < STRINGS; i += 2) {
+        hash_set_remove(set, copies[i]);
+    }
+
+    CHECK(hash_set_size(set) == STRINGS / 2);
+    size_t visited = 0;
+    for (hash_set_iterator_t it = hash_set_begin(set); hash_set_is_valid(it); it = hash_set_next(it)) {
+        CHECK(is_name(hash_set_value(it), 1));
+        visited++;
+    }
+
+    CHECK(visited == STRINGS / 2);
+    for (size_t i = 0; i < STRINGS; i++) {
+        CHECK(hash_set_contains(set, copies[i]) == (i % 2 == 1));
+    }
+
+    hash_set_release(set);
+    return 0;
+}
+
+/**
+ * Combines a set of names with a set of copies of other names, so elements
+ * only match by contents: the elements of each result must be the strings
+ * of the set they were taken from.
+ */
+static int test_strings_algebra(void)
+{
+    hash_set_t* odds = hash_set_new_mode(HASH_TABLE_STRING, 0);
+    hash_set_t* thirds = hash_set_new_mode(HASH_TABLE_STRING, 0);
+    CHECK(odds != NULL && thirds != NULL);
+
+    for (size_t i = 0; i < STRINGS; i++) {
+        if (i % 2 == 1) {
+            CHECK(hash_set_push(odds, names[i]) == 0);
+        }
+
+        if (i % 3 == 0) {
+            CHECK(hash_set_push(thirds, copies[i]) == 0);
+        }
+    }
+
+    hash_set_t* result = hash_set_union(odds, thirds);
+    CHECK(result != NULL);
+    CHECK(hash_set_mode(result) == HASH_TABLE_STRING);
+    CHECK(hash_set_size(result) == STRINGS / 2 + STRINGS / 3 - STRINGS / 6);
+    hash_set_release(result);
+
+    result = hash_set_intersect(thirds, odds);
+    CHECK(result != NULL);
+    CHECK(hash_set_size(result) == STRINGS / 6);
+    for (size_t i = 0; i < STRINGS; i++) {
+        CHECK(hash_set_contains(result, names[i]) == (i % 6 == 3));
+    }
+
+    hash_set_release(result);
+
+    result = hash_set_difference(odds, thirds);
+    CHECK(result != NULL);
+    CHECK(hash_set_size(result) == STRINGS / 2 - STRINGS / 6);
+    for (hash_set_iterator_t it = hash_set_begin(result); hash_set_is_valid(it); it = hash_set_next(it)) {
+        CHECK(is_name(hash_set_value(it), 1));
+        CHECK(!hash_set_contains(thirds, hash_set_value(it)));
+    }
+
+    hash_set_release(result);
+    hash_set_release(odds);
+    hash_set_release(thirds);
+    return 0;
+}
+
+int main(void)
+{
+    int failed = 0;
+    failed |= test_algebra();
+    failed |= test_algebra_edges();
+    failed |= test_algebra_after_remove();
+    failed |= test_strings();
+    failed |= test_strings_algebra();
+    return failed;
+}
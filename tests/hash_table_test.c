@@ -0,0 +1,484 @@
+#include "check.h"
+#include "hash.h"
+#include "marlo/hash_table.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#define KEY(i) ((const void*) (uintptr_t) ((i) * 8 + 8))
+#define NORMAL_KEYS 400
+#define COLLIDING_KEYS 300
+#define COLLIDING_BITS 12
+#define GENERATIONS 65536
+
+/**
+ * Grows an auto-shrinking table, shrinks it by removing the most recent keys
+ * and grows it again, checking every key along the way, down to the 8 keys
+ * `hash_table_shrink_to_fit()` moves back inline.
+ * Removing from the end keeps the entries dense, so an incremental table
+ * shrinks without compacting them.
+ */
+static int test_grow_shrink_grow(int flags)
+{
+    hash_table_t* table = hash_table_new(HASH_TABLE_ADDRESS | flags, 1024);
+    CHECK(table != NULL);
+
+    for (size_t i = 0; i < 700; i++) {
+        CHECK(hash_table_push(table, KEY(i), KEY(i)) == 0);
+    }
+
+    for (size_t i = 700; i > 100; i--) {
+        hash_table_remove(table, KEY(i - 1));
+    }
+
+    CHECK(hash_table_size(table) == 100);
+    CHECK(hash_table_capacity(table) < 1024);
+
+    for (size_t i = 100; i < 5000; i++) {
+        CHECK(hash_table_push(table, KEY(i), KEY(i)) == 0);
+        CHECK(hash_table_load_factor(table) <= 0.8f);
+    }
+
+    CHECK(hash_table_size(table) == 5000);
+    for (size_t i = 0; i < 5000; i++) {
+        CHECK(hash_table_at(table, KEY(i)) == KEY(i));
+    }
+
+    for (size_t i = 0; i < 4990; i++) {
+        hash_table_remove(table, KEY(i));
+    }
+
+    for (size_t i = 4990; i < 5000; i++) {
+        CHECK(hash_table_at(table, KEY(i)) == KEY(i));
+    }
+
+    hash_table_remove(table, KEY(4990));
+    hash_table_remove(table, KEY(4991));
+    CHECK(hash_table_shrink_to_fit(table) == 0);
+    CHECK(hash_table_capacity(table) == 8);
+    for (size_t i = 4992; i < 5000; i++) {
+        CHECK(hash_table_at(table, KEY(i)) == KEY(i));
+    }
+
+    hash_table_release(table);
+    return 0;
+}
+
+static uint64_t counted_hash(const void* key, void* ctx)
+{
+    ((size_t*) ctx)[0]++;
+    return (uint64_t) (uintptr_t) key * 0x9e3779b97f4a7c15;
+}
+
+static int counted_equals(const void* key, const void* other, void* ctx)
+{
+    ((size_t*) ctx)[1]++;
+    return key == other;
+}
+
+static const void* drop_even(const void* key, const void* value, void* ctx)
+{
+    (void) ctx;
+    return ((uintptr_t) key / 8 - 1) % 2 == 1 ? value : NULL;
+}
+
+/**
+ * Removes every other key through `hash_table_update_with`, which must hash
+ * and compare each key once and erase the entry it found, in small and
+ * indexed tables.
+ */
+static int test_update_with_remove(int flags, size_t count)
+{
+    size_t calls[2] = {0, 0};
+    hash_table_t* table = hash_table_new_custom(flags, 0, counted_hash, counted_equals, calls);
+    CHECK(table != NULL);
+
+    for (size_t i = 0; i < count; i++) {
+        CHECK(hash_table_push(table, KEY(i), KEY(i)) == 0);
+    }
+
+    calls[0] = 0;
+    calls[1] = 0;
+    for (size_t i = 0; i < count; i++) {
+        CHECK(hash_table_update_with(table, KEY(i), drop_even, NULL) == 0);
+    }
+
+    CHECK(calls[0] == count);
+    CHECK(calls[1] == count);
+    CHECK(hash_table_size(table) == count / 2);
+    for (size_t i = 0; i < count; i++) {
+        CHECK(hash_table_at(table, KEY(i)) == (i % 2 == 1 ? KEY(i) : NULL));
+    }
+
+    hash_table_release(table);
+    return 0;
+}
+
+/**
+ * Erases every third key while iterating, checking that the iterator
+ * returned by `hash_table_erase()` goes on with the next key in insertion
+ * order and that no key is hashed or compared along the way.
+ */
+static int test_erase(int flags, size_t count)
+{
+    size_t calls[2] = {0, 0};
+    hash_table_t* table = hash_table_new_custom(flags, 0, counted_hash, counted_equals, calls);
+    CHECK(table != NULL);
+
+    for (size_t i = 0; i < count; i++) {
+        CHECK(hash_table_push(table, KEY(i), KEY(i)) == 0);
+    }
+
+    calls[0] = 0;
+    calls[1] = 0;
+    size_t visited = 0;
+    hash_table_iterator_t it = hash_table_begin(table);
+    while (hash_table_is_valid(it)) {
+        CHECK(hash_table_item(it).key == KEY(visited));
+        it = visited % 3 == 0 ? hash_table_erase(table, it) : hash_table_next(it);
+        visited++;
+    }
+
+    CHECK(visited == count);
+    CHECK(calls[0] == 0 && calls[1] == 0);
+    CHECK(hash_table_size(table) == count - (count + 2) / 3);
+    for (size_t i = 0; i < count; i++) {
+        CHECK(hash_table_at(table, KEY(i)) == (i % 3 != 0 ? KEY(i) : NULL));
+    }
+
+    size_t last = count - (count % 3 == 1 ? 2 : 1);
+    it = hash_table_begin(table);
+    while (hash_table_item(it).key != KEY(last)) {
+        it = hash_table_next(it);
+    }
+
+    CHECK(!hash_table_is_valid(hash_table_erase(table, it)));
+    CHECK(hash_table_at(table, KEY(last)) == NULL);
+    CHECK(!hash_table_is_valid(hash_table_erase(table, it)));
+
+    hash_table_release(table);
+    return 0;
+}
+
+static int keep_multiple(const void* key, const void* value, void* ctx)
+{
+    (void) value;
+    size_t* calls = (size_t*) ctx;
+    calls[2]++;
+    return ((uintptr_t) key / 8 - 1) % calls[3] == 0;
+}
+
+/**
+ * Keeps the keys that are multiples of 3, then of 6, through
+ * `hash_table_retain()`, which must call the predicate once per key and
+ * neither hash nor compare any of them, and leave a table that takes new
+ * keys.
+ */
+static int test_retain(int flags, size_t count)
+{
+    size_t calls[4] = {0, 0, 0, 3};
+    hash_table_t* table = hash_table_new_custom(flags, 0, counted_hash, counted_equals, calls);
+    CHECK(table != NULL);
+
+    for (size_t i = 0; i < count; i++) {
+        CHECK(hash_table_push(table, KEY(i), KEY(i)) == 0);
+    }
+
+    calls[0] = 0;
+    calls[1] = 0;
+    size_t kept = (count + 2) / 3;
+    CHECK(hash_table_retain(table, keep_multiple, calls) == count - kept);
+    CHECK(calls[0] == 0 && calls[1] == 0);
+    CHECK(calls[2] == count);
+    CHECK(hash_table_size(table) == kept);
+
+    calls[2] = 0;
+    calls[3] = 6;
+    CHECK(hash_table_retain(table, keep_multiple, calls) == kept - (count + 5) / 6);
+    CHECK(calls[2] == kept);
+
+    for (size_t i = count; i < 2 * count; i++) {
+        CHECK(hash_table_push(table, KEY(i), KEY(i)) == 0);
+    }
+
+    CHECK(hash_table_size(table) == (count + 5) / 6 + count);
+    for (size_t i = 0; i < 2 * count; i++) {
+        CHECK(hash_table_at(table, KEY(i)) == (i % 6 == 0 || i >= count ? KEY(i) : NULL));
+    }
+
+    CHECK(hash_table_retain(table, keep_multiple, calls) >= count / 2);
+    CHECK(hash_table_retain(NULL, keep_multiple, calls) == 0);
+    CHECK(hash_table_retain(table, NULL, calls) == 0);
+
+    hash_table_release(table);
+    return 0;
+}
+
+/**
+ * Keeps a window of live keys sliding forward by removing the oldest key
+ * and pushing a new one, which leaves removed entries behind that an
+ * incremental table must compact away a few at a time.
+ * Every live key must stay reachable, iteration must keep them in insertion
+ * order and the capacity must not grow with the number of removals.
+ */
+static int test_churn(int flags)
+{
+    hash_table_t* table = hash_table_new(HASH_TABLE_ADDRESS | flags, 0);
+    CHECK(table != NULL);
+
+    for (size_t i = 0; i < 3000; i++) {
+        CHECK(hash_table_push(table, KEY(i), KEY(i)) == 0);
+    }
+
+    size_t capacity = hash_table_capacity(table);
+    for (size_t i = 0; i < 50000; i++) {
+        hash_table_remove(table, KEY(i));
+        CHECK(hash_table_push(table, KEY(i + 3000), KEY(i + 3000)) == 0);
+    }
+
+    CHECK(hash_table_size(table) == 3000);
+    CHECK(hash_table_capacity(table) <= capacity * 2);
+    for (size_t i = 0; i < 53000; i++) {
+        CHECK(hash_table_at(table, KEY(i)) == (i >= 50000 ? KEY(i) : NULL));
+    }
+
+    uintptr_t previous = 0;
+    for (hash_table_iterator_t it = hash_table_begin(table); hash_table_is_valid(it); it = hash_table_next(it)) {
+        uintptr_t key = (uintptr_t) hash_table_item(it).key;
+        CHECK(key > previous);
+        previous = key;
+    }
+
+    hash_table_release(table);
+    return 0;
+}
+
+/**
+ * Removes all but every thousandth owned key and pushes as many new ones,
+ * so the table compacts and trims its keys.
+ * The keys kept must stay where the table first returned them, and
+ * removing them too must give their chunks back.
+ */
+static int test_own_keys_trim(int flags)
+{
+    hash_table_t* table = hash_table_new(HASH_TABLE_STRING | HASH_TABLE_OWN_KEYS | flags, 0);
+    CHECK(table != NULL);
+
+    char key[24];
+    for (size_t i = 0; i < 20000; i++) {
+        snprintf(key, sizeof(key), "key-%zu", i);
+        CHECK(hash_table_push(table, key, KEY(i)) == 0);
+    }
+
+    const char* kept[20];
+    size_t count = 0;
+    hash_table_iterator_t it = hash_table_begin(table);
+    while (hash_table_is_valid(it)) {
+        size_t i = (size_t) ((uintptr_t) hash_table_item(it).value / 8 - 1);
+        if (i % 1000 == 0) {
+            kept[count++] = (const char*) hash_table_item(it).key;
+            it = hash_table_next(it);
+        } else {
+            it = hash_table_erase(table, it);
+        }
+    }
+
+    CHECK(count == 20);
+    for (size_t i = 20000; i < 40000; i++) {
+        snprintf(key, sizeof(key), "key-%zu", i);
+        CHECK(hash_table_push(table, key, KEY(i)) == 0);
+    }
+
+    CHECK(hash_table_shrink_to_fit(table) == 0);
+    for (size_t i = 0; i < count; i++) {
+        snprintf(key, sizeof(key), "key-%zu", i * 1000);
+        CHECK(strcmp(kept[i], key) == 0);
+        CHECK(hash_table_at(table, kept[i]) == KEY(i * 1000));
+    }
+
+    hash_table_stats_t before;
+    CHECK(hash_table_stats(table, &before) == 0);
+    for (size_t i = 0; i < count; i++) {
+        hash_table_remove(table, kept[i]);
+    }
+
+    for (size_t i = 20000; i < 39000; i++) {
+        snprintf(key, sizeof(key), "key-%zu", i);
+        hash_table_remove(table, key);
+    }
+
+    CHECK(hash_table_shrink_to_fit(table) == 0);
+    hash_table_stats_t after;
+    CHECK(hash_table_stats(table, &after) == 0);
+    CHECK(after.size == 1000);
+    CHECK(after.key_bytes < before.key_bytes);
+    for (size_t i = 39000; i < 40000; i++) {
+        snprintf(key, sizeof(key), "key-%zu", i);
+        CHECK(hash_table_at(table, key) == KEY(i));
+    }
+
+    hash_table_release(table);
+    return 0;
+}
+
+/**
+ * Fills an indexed table with 40 keys, then clears it and refills it with
+ * only 9 of them more times than there are slot generations.
+ * The slots of the 31 other keys are never written again, so they must not
+ * be taken for live ones once the generations wrap around to the one they
+ * were written in.
+ */
+static int test_clear_generations(void)
+{
+    hash_table_t* table = hash_table_new(HASH_TABLE_ADDRESS, 64);
+    CHECK(table != NULL);
+
+    for (size_t i = 0; i < 40; i++) {
+        CHECK(hash_table_push(table, KEY(i), KEY(i)) == 0);
+    }
+
+    for (size_t round = 1; round <= GENERATIONS + 1; round++) {
+        hash_table_clear(table);
+        CHECK(hash_table_is_empty(table));
+        for (size_t i = 0; i < 9; i++) {
+            CHECK(hash_table_push(table, KEY(i), KEY(round)) == 0);
+        }
+
+        CHECK(hash_table_size(table) == 9);
+        for (size_t i = 0; i < 40; i++) {
+            CHECK(hash_table_at(table, KEY(i)) == (i < 9 ? KEY(round) : NULL));
+        }
+    }
+
+    CHECK(hash_table_capacity(table) == 64);
+    for (size_t i = 9; i < 48; i++) {
+        CHECK(hash_table_push(table, KEY(i), KEY(i)) == 0);
+    }
+
+    size_t visited = 0;
+    for (hash_table_iterator_t it = hash_table_begin(table); hash_table_is_valid(it); it = hash_table_next(it)) {
+        CHECK(hash_table_item(it).key == KEY(visited));
+        visited++;
+    }
+
+    CHECK(visited == 48);
+    CHECK(hash_table_capacity(table) == 64);
+    hash_table_release(table);
+    return 0;
+}
+
+/**
+ * Clears a table at every size while it grows, so some clears land in the
+ * middle of an incremental rehash, and refills it with keys that must be the
+ * only ones found.
+ */
+static int test_clear_growing(int flags)
+{
+    hash_table_t* table = hash_table_new(HASH_TABLE_ADDRESS | flags, 0);
+    CHECK(table != NULL);
+
+    for (size_t size = 0; size < 600; size += 7) {
+        for (size_t i = 0; i < size; i++) {
+            CHECK(hash_table_push(table, KEY(i), KEY(i)) == 0);
+        }
+
+        hash_table_clear(table);
+        for (size_t i = size; i < size + 50; i++) {
+            CHECK(hash_table_push(table, KEY(i), KEY(i)) == 0);
+        }
+
+        CHECK(hash_table_size(table) == 50);
+        for (size_t i = 0; i < size + 60; i++) {
+            CHECK(hash_table_at(table, KEY(i)) == (i >= size && i < size + 50 ? KEY(i) : NULL));
+        }
+
+        hash_table_clear(table);
+    }
+
+    hash_table_release(table);
+    return 0;
+}
+
+static char flood_keys[NORMAL_KEYS + COLLIDING_KEYS][24];
+
+/**
+ * Mixes keys whose unkeyed hashes share their top bits, so they all land in
+ * the same home slot, with ordinary keys, in the given order (colliding ones
+ * last, first or interleaved).
+ * The table must notice the long probe among the short ones and switch to
+ * keyed hashing.
+ */
+static int test_flood_mixed(int order)
+{
+    size_t normal = 0;
+    size_t colliding = 0;
+    for (size_t i = 0; normal < NORMAL_KEYS || colliding < COLLIDING_KEYS; i++) {
+        char key[24];
+        int size = snprintf(key, sizeof(key), "key-%zu", i);
+        int collides = hash_bytes(key, (size_t) size, 0) >> (64 - COLLIDING_BITS) == 0;
+        if (collides && colliding < COLLIDING_KEYS) {
+            memcpy(flood_keys[NORMAL_KEYS + colliding++], key, (size_t) size + 1);
+        } else if (!collides && normal < NORMAL_KEYS) {
+            memcpy(flood_keys[normal++], key, (size_t) size + 1);
+        }
+    }
+
+    hash_table_t* table = hash_table_new(HASH_TABLE_STRING, 1024);
+    CHECK(table != NULL);
+
+    for (size_t i = 0; i < NORMAL_KEYS + COLLIDING_KEYS; i++) {
+        size_t pos = i;
+        if (order == 1) {
+            pos = (i + NORMAL_KEYS) % (NORMAL_KEYS + COLLIDING_KEYS);
+        } else if (order == 2 && i < 2 * COLLIDING_KEYS) {
+            pos = i % 2 == 0 ? NORMAL_KEYS + i / 2 : i / 2;
+        } else if (order == 2) {
+            pos = i - COLLIDING_KEYS;
+        }
+
+        CHECK(hash_table_push(table, flood_keys[pos], flood_keys[pos]) == 0);
+    }
+
+    hash_table_stats_t stats;
+    CHECK(hash_table_stats(table, &stats) == 0);
+    CHECK(hash_table_is_keyed(table));
+    CHECK(stats.max_probe <= 64);
+    CHECK(hash_table_size(table) == NORMAL_KEYS + COLLIDING_KEYS);
+    for (size_t i = 0; i < NORMAL_KEYS + COLLIDING_KEYS; i++) {
+        CHECK(hash_table_at(table, flood_keys[i]) == flood_keys[i]);
+    }
+
+    hash_table_release(table);
+    return 0;
+}
+
+int main(void)
+{
+    int failed = 0;
+    failed |= test_grow_shrink_grow(HASH_TABLE_AUTO_SHRINK);
+    failed |= test_grow_shrink_grow(HASH_TABLE_INCREMENTAL | HASH_TABLE_AUTO_SHRINK);
+    failed |= test_update_with_remove(0, 6);
+    failed |= test_update_with_remove(0, 1000);
+    failed |= test_update_with_remove(HASH_TABLE_INCREMENTAL | HASH_TABLE_AUTO_SHRINK, 1000);
+    failed |= test_erase(0, 7);
+    failed |= test_erase(0, 1000);
+    failed |= test_erase(HASH_TABLE_INCREMENTAL, 1000);
+    failed |= test_erase(HASH_TABLE_INCREMENTAL | HASH_TABLE_AUTO_SHRINK, 1000);
+    failed |= test_retain(0, 7);
+    failed |= test_retain(0, 1000);
+    failed |= test_retain(HASH_TABLE_INCREMENTAL, 1000);
+    failed |= test_retain(HASH_TABLE_INCREMENTAL | HASH_TABLE_AUTO_SHRINK, 1000);
+    failed |= test_churn(0);
+    failed |= test_churn(HASH_TABLE_INCREMENTAL);
+    failed |= test_churn(HASH_TABLE_INCREMENTAL | HASH_TABLE_AUTO_SHRINK);
+    failed |= test_own_keys_trim(0);
+    failed |= test_own_keys_trim(HASH_TABLE_INCREMENTAL);
+    failed |= test_clear_generations();
+    failed |= test_clear_growing(0);
+    failed |= test_clear_growing(HASH_TABLE_INCREMENTAL);
+    failed |= test_flood_mixed(0);
+    failed |= test_flood_mixed(1);
+    failed |= test_flood_mixed(2);
+    return failed;
+}
@@ -0,0 +1,229 @@
+#include "check.h"
+#include "marlo/vector.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define PATTERNS 6
+#define VALUE(i) ((const void*) (uintptr_t) ((i) + 1))
+#define STABLE_SHIFT (sizeof(uintptr_t) * 8 - 8)
+
+static const size_t sizes[] = {0, 1, 2, 3, 23, 24, 25, 129, 1000, 100000};
+static const size_t parallel_sizes[] = {0, 1, 1000, 65535, 65536, 98311, 300007};
+static size_t parallel_threads;
+
+static int compare(const void* a, const void* b)
+{
+    uintptr_t x = (uintptr_t) a;
+    uintptr_t y = (uintptr_t) b;
+    return (x > y) - (x < y);
+}
+
+/**
+ * Compares the top byte of the values only, the key of `check_stable()`.
+ */
+static int compare_high(const void* a, const void* b)
+{
+    uintptr_t x = (uintptr_t) a >> STABLE_SHIFT;
+    uintptr_t y = (uintptr_t) b >> STABLE_SHIFT;
+    return (x > y) - (x < y);
+}
+
+static int compare_qsort(const void* a, const void* b)
+{
+    return compare(*(const void* const*) a, *(const void* const*) b);
+}
+
+static uint64_t next_random(uint64_t* state)
+{
+    *state ^= *state << 13;
+    *state ^= *state >> 7;
+    *state ^= *state << 17;
+    return *state;
+}
+
+/**
+ * Fills `values` with `count` values in one of the patterns sorts are known
+ * to trip on: random, sorted, reversed, few unique, organ pipe and sorted
+ * with a few values swapped.
+ */
+static void fill_pattern(int pattern, const void** values, size_t count)
+{
+    uint64_t state = UINT64_C(0x9e3779b97f4a7c15) + (uint64_t) pattern;
+    for (size_t i = 0; i < count; i++) {
+        uint64_t value = 0;
+        switch (pattern) {
+        case 0:
+            value = next_random(&state) >> 1;
+            break;
+        case 1:
+            value = i;
+            break;
+        case 2:
+            value = count - i;
+            break;
+        case 3:
+            value = next_random(&state) % 4;
+            break;
+        case 4:
+            value = i < count / 2 ? i : count - i;
+            break;
+        default:
+            value = i % 100 == 0 && i > 0 ? i - 1 : i;
+            break;
+        }
+
+        values[i] = VALUE(value);
+    }
+}
+
+/**
+ * Sorts every pattern at each of the given sizes, the largest last, with
+ * `sort` and checks the result against qsort.
+ */
+static int check_sort(int (*sort)(vector_t*, compare_t), const size_t* counts, size_t length)
+{
+    const void** values = (const void**) malloc(counts[length - 1] * sizeof(*values));
+    vector_t* vector = vector_new(0);
+    CHECK(values != NULL && vector != NULL);
+
+    for (size_t s = 0; s < length; s++) {
+        for (int pattern = 0; pattern < PATTERNS; pattern++) {
+            size_t count = counts[s];
+            fill_pattern(pattern, values, count);
+            vector_clear(vector);
+            for (size_t i = 0; i < count; i++) {
+                CHECK(vector_push(vector, values[i]) == 0);
+            }
+
+            qsort(values, count, sizeof(*values), compare_qsort);
+            CHECK(sort(vector, compare) == 0);
+            CHECK(vector_size(vector) == count);
+            for (size_t i = 0; i < count; i++) {
+                CHECK(vector_at(vector, i) == values[i]);
+            }
+        }
+    }
+
+    vector_release(vector);
+    free(values);
+    return 0;
+}
+
+/**
+ * Sorts every pattern at every size with `sort`, which must order values by
+ * their top byte and keep equal ones in their original order.
+ * Each value holds its key in its top byte and its original position below
+ * it, so the stable order is the one qsort gives comparing whole values.
+ */
+static int check_stable(int (*sort)(vector_t*))
+{
+    size_t max_size = sizes[sizeof(sizes) / sizeof(*sizes) - 1];
+    const void** values = (const void**) malloc(max_size * sizeof(*values));
+    vector_t* vector = vector_new(0);
+    CHECK(values != NULL && vector != NULL);
+
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(*sizes); s++) {
+        for (int pattern = 0; pattern < PATTERNS; pattern++) {
+            size_t count = sizes[s];
+            fill_pattern(pattern, values, count);
+            vector_clear(vector);
+            for (size_t i = 0; i < count; i++) {
+                uintptr_t value = (uintptr_t) values[i];
+                uintptr_t key = pattern == 0 || pattern == 3 ? value % 256 : value * 255 / (count + 2);
+                values[i] = (const void*) (key << STABLE_SHIFT | (i + 1));
+                CHECK(vector_push(vector, values[i]) == 0);
+            }
+
+            qsort(values, count, sizeof(*values), compare_qsort);
+            CHECK(sort(vector) == 0);
+            CHECK(vector_size(vector) == count);
+            for (size_t i = 0; i < count; i++) {
+                CHECK(vector_at(vector, i) == values[i]);
+            }
+        }
+    }
+
+    vector_release(vector);
+    free(values);
+    return 0;
+}
+
+static int test_sort(void)
+{
+    CHECK(vector_sort(NULL, compare) == -1);
+    return check_sort(vector_sort, sizes, sizeof(sizes) / sizeof(*sizes));
+}
+
+static int sort_parallel(vector_t* vector, compare_t compare)
+{
+    return vector_sort_parallel(vector, compare, parallel_threads);
+}
+
+/**
+ * Sorts in parallel on thread counts that don't divide the sizes, so the
+ * merge path splits land in the middle of runs of equal values.
+ */
+static int test_sort_parallel(void)
+{
+    CHECK(vector_sort_parallel(NULL, compare, 2) == -1);
+    for (parallel_threads = 0; parallel_threads <= 5; parallel_threads++) {
+        CHECK(check_sort(sort_parallel, parallel_sizes, sizeof(parallel_sizes) / sizeof(*parallel_sizes)) == 0);
+    }
+
+    parallel_threads = 8;
+    return check_sort(sort_parallel, parallel_sizes, sizeof(parallel_sizes) / sizeof(*parallel_sizes));
+}
+
+static int stable_sort_high(vector_t* vector)
+{
+    return vector_stable_sort(vector, compare_high);
+}
+
+static int test_stable_sort(void)
+{
+    CHECK(vector_stable_sort(NULL, compare) == -1);
+    CHECK(check_sort(vector_stable_sort, sizes, sizeof(sizes) / sizeof(*sizes)) == 0);
+    return check_stable(stable_sort_high);
+}
+
+static uint64_t key_value(const void* value, void* ctx)
+{
+    (void) ctx;
+    return (uint64_t) (uintptr_t) value;
+}
+
+static uint64_t key_high(const void* value, void* ctx)
+{
+    (void) ctx;
+    return (uint64_t) ((uintptr_t) value >> STABLE_SHIFT);
+}
+
+static int sort_by_value(vector_t* vector, compare_t compare)
+{
+    (void) compare;
+    return vector_sort_by_key(vector, key_value, NULL);
+}
+
+static int sort_by_high(vector_t* vector)
+{
+    return vector_sort_by_key(vector, key_high, NULL);
+}
+
+static int test_sort_by_key(void)
+{
+    CHECK(vector_sort_by_key(NULL, key_value, NULL) == -1);
+    CHECK(check_sort(sort_by_value, sizes, sizeof(sizes) / sizeof(*sizes)) == 0);
+    return check_stable(sort_by_high);
+}
+
+int main(void)
+{
+    int failed = 0;
+    failed |= test_sort();
+    failed |= test_sort_parallel();
+    failed |= test_stable_sort();
+    failed |= test_sort_by_key();
+    return failed;
+}